@@ -12,6 +12,253 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include "TextFileLoad.h"
+#include <cstring>
+#include <charconv>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+#include <unordered_map>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/////////////////////////////////////////////////////////////////////////////
+// COLUMN CONVERSION HELPERS
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+Copies a vector of one numeric type into a vector of another. The plain indexed loop over
+contiguous storage lets the compiler vectorize the conversion.
+*/
+template <typename S, typename D>
+static void _convertValues(const vector<S>& src, vector<D>& dst)
+{
+	size_t n = src.size();
+	dst.resize(n);
+	if(n == 0)
+		return;
+	const S* from = &src[0];
+	D* to = &dst[0];
+	for(size_t i = 0; i < n; i++)
+		to[i] = (D)from[i];
+}
+
+/*
+vector<bool> is itself bit-packed, so it cannot be written through a pointer.
+*/
+template <typename S>
+static void _convertValues(const vector<S>& src, vector<bool>& dst)
+{
+	size_t n = src.size();
+	dst.resize(n);
+	for(size_t i = 0; i < n; i++)
+		dst[i] = (src[i] != 0);
+}
+
+/*
+Formats a numeric vector as strings, converting each value to type A first. std::to_chars writes
+the shortest text that reads back to the same value, so doubles keep full precision and large
+numbers are never truncated. The output is sized once up front and each string is assigned in place.
+*/
+template <typename A, typename S>
+static void _formatValues(const vector<S>& src, vector<string>& dst)
+{
+	char conv[32]; //Large enough for any int64 and any double in shortest form
+	size_t n = src.size();
+	dst.resize(n);
+	for(size_t i = 0; i < n; i++)
+	{
+		to_chars_result res = to_chars(conv, conv + sizeof(conv), (A)src[i]);
+		dst[i].assign(conv, res.ptr);
+	}
+}
+
+/*
+Scrambles a 64-bit value so that every input bit affects every output bit (splitmix64 finalizer).
+*/
+static inline uint64_t _mixHash(uint64_t h)
+{
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	return h ^ (h >> 31);
+}
+
+/*
+Returns the number of worker threads to use for n items of work, allowing at least min_items
+per worker. The result is always a power of two so that it can select hash partitions by bits.
+*/
+static unsigned _workerCount(int64_t n, int64_t min_items)
+{
+	unsigned hardware = thread::hardware_concurrency();
+	unsigned workers = 1;
+	while(workers * 2 <= hardware && workers * 2 <= 64 && n / (workers * 2) >= min_items)
+		workers *= 2;
+	return workers;
+}
+
+/*
+Returns the length of the prefix of text[0, n) made of complete, valid UTF-8 sequences: it stops
+at the first invalid byte, or at a sequence cut off by the end of the buffer. Runs of ASCII,
+which is most text in data files, are checked eight bytes at a time.
+*/
+static size_t _validUtf8(const unsigned char* text, size_t n)
+{
+	size_t i = 0;
+	while(i < n)
+	{
+		uint64_t word;
+		if(i + 8 <= n)
+		{
+			memcpy(&word, text + i, 8);
+			if((word & 0x8080808080808080ULL) == 0)
+			{
+				i += 8;
+				continue;
+			}
+		}
+		unsigned char c = text[i];
+		if(c < 0x80)
+		{
+			i++;
+			continue;
+		}
+
+		//Lead byte: length of the sequence, and the range of its second byte that excludes
+		//overlong forms, surrogates and code points above U+10FFFF
+		size_t len;
+		unsigned char low = 0x80, high = 0xBF;
+		if(c >= 0xC2 && c <= 0xDF)
+			len = 2;
+		else if(c >= 0xE0 && c <= 0xEF)
+		{
+			len = 3;
+			if(c == 0xE0) low = 0xA0;
+			if(c == 0xED) high = 0x9F;
+		}
+		else if(c >= 0xF0 && c <= 0xF4)
+		{
+			len = 4;
+			if(c == 0xF0) low = 0x90;
+			if(c == 0xF4) high = 0x8F;
+		}
+		else
+			return i;
+
+		if(i + len > n)
+			return i;
+		if(text[i + 1] < low || text[i + 1] > high)
+			return i;
+		for(size_t k = 2; k < len; k++)
+		{
+			if((text[i + k] & 0xC0) != 0x80)
+				return i;
+		}
+		i += len;
+	}
+	return i;
+}
+
+/*
+Unpacks the first n bits of a bit-packed column.
+*/
+template <typename D>
+static void _unpackBits(const vector<uint64_t>& src, long n, vector<D>& dst)
+{
+	dst.resize(n);
+	for(long i = 0; i < n; i++)
+		dst[i] = (D)((src[i / 64] >> (i % 64)) & 1);
+}
+
+/*
+Moves a column of 0/1 values held in st_int8 to st_bit, 64 rows per word. Whole words are built
+from 64 values at a time. In memory budget mode only the resident values are packed: spilled
+bits are kept one per byte either way.
+*/
+static void _packBits(column& col)
+{
+	if(col.st_type != _ST_INT8)
+		return;
+	const int8_t* values = col.st_int8.data();
+	size_t n = col.st_int8.size();
+	col.st_bit.assign((n + 63) / 64, 0);
+	for(size_t word = 0; word < n / 64; word++)
+	{
+		uint64_t bits = 0;
+		for(int i = 0; i < 64; i++)
+			bits |= (uint64_t)(values[word * 64 + i] != 0) << i;
+		col.st_bit[word] = bits;
+	}
+	for(size_t i = n & ~(size_t)63; i < n; i++)
+		col.st_bit[i / 64] |= (uint64_t)(values[i] != 0) << (i % 64);
+	vector<int8_t>().swap(col.st_int8);
+	col.st_type = _ST_BIT;
+}
+
+/*
+Widens a column type so that it also holds a value of value_type, as type inference does row by
+row. has_value says whether the column already holds a non-null value. Dates and timestamps do
+not mix with numbers: a column with both is a string column.
+*/
+static void _widenType(_VT_TYPE& type, bool has_value, int value_type)
+{
+	bool dated = (value_type == _VT_DATE || value_type == _VT_TIMESTAMP);
+	if(has_value && dated != (type == _VT_DATE || type == _VT_TIMESTAMP) && type != _VT_STRING)
+		value_type = _VT_STRING;
+
+	switch(value_type)
+	{
+		case _VT_BOOL:
+			break;
+
+		case _VT_INT:
+			if(type==_VT_BOOL)
+				type = _VT_INT;
+			break;
+
+		case _VT_LONG:
+			if(type==_VT_BOOL || type==_VT_INT)
+				type = _VT_LONG;
+			break;
+
+		case _VT_DOUBLE:
+			if(type!=_VT_STRING)
+				type = _VT_DOUBLE;
+			break;
+
+		case _VT_DATE:
+			if(type!=_VT_STRING && type!=_VT_TIMESTAMP)
+				type = _VT_DATE;
+			break;
+
+		case _VT_TIMESTAMP:
+			if(type!=_VT_STRING)
+				type = _VT_TIMESTAMP;
+			break;
+
+		case _VT_STRING:
+			type = _VT_STRING;
+	}
+}
+
+/*
+Appends the values of src to those of dst, which has the same storage type, and releases src.
+*/
+static void _appendColumn(column& dst, column& src)
+{
+	dst.st_int8.insert(dst.st_int8.end(), src.st_int8.begin(), src.st_int8.end());
+	dst.st_int16.insert(dst.st_int16.end(), src.st_int16.begin(), src.st_int16.end());
+	dst.st_int32.insert(dst.st_int32.end(), src.st_int32.begin(), src.st_int32.end());
+	dst.st_int64.insert(dst.st_int64.end(), src.st_int64.begin(), src.st_int64.end());
+	dst.st_float.insert(dst.st_float.end(), src.st_float.begin(), src.st_float.end());
+	dst.st_double.insert(dst.st_double.end(), src.st_double.begin(), src.st_double.end());
+	dst.st_string.insert(dst.st_string.end(), make_move_iterator(src.st_string.begin()), make_move_iterator(src.st_string.end()));
+	src = column();
+}
 
 /////////////////////////////////////////////////////////////////////////////
 // CONSTRUCTORS AND DESTRUCTOR
@@ -22,16 +269,7 @@ This constructor assumes a tab-delimited file. Default argument for headers is t
 */
 TextFileLoad::TextFileLoad(string textfile, bool headers)
 {
-	//Set member properties
-	filename = textfile;
-	delimiter = '\t';
-	header_row = headers;
-
-	//Load file data
-	_openFile();
-	_getFieldNames();
-	_getFieldTypes();
-	_getData();
+	_init(textfile, TextFileLoadOptions('\t', headers));
 }
 
 /*
@@ -39,24 +277,49 @@ This constructor allows the user to specify the delimiter. Default argument for
 */
 TextFileLoad::TextFileLoad(string textfile, char delimit, bool headers)
 {
-	//Set member properties
-	filename = textfile;
-	delimiter = delimit;
-	header_row = headers;
+	_init(textfile, TextFileLoadOptions(delimit, headers));
+}
 
-	//Load file data
-	_openFile();
-	_getFieldNames();
-	_getFieldTypes();
-	_getData();
+/*
+This constructor takes all settings from a TextFileLoadOptions structure, e.g. to declare a schema.
+*/
+TextFileLoad::TextFileLoad(string textfile, const TextFileLoadOptions& opts)
+{
+	_init(textfile, opts);
+}
+
+/*
+This constructor joins two loaded datasets on a key column of each; see _join(). Default is an
+inner join with case-insensitive column names.
+*/
+TextFileLoad::TextFileLoad(const TextFileLoad& left, const TextFileLoad& right, string left_key, string right_key, bool keep_unmatched, bool case_sensitive)
+{
+	_join(left, right, left._getColNum(left_key, case_sensitive), right._getColNum(right_key, case_sensitive), keep_unmatched);
 }
 
 /*
-The destructor ensures that the file input stream is closed.
+The destructor ensures that the file input stream is closed and that spill files and any UTF-8
+copy of the file are removed.
 */
 TextFileLoad::~TextFileLoad(void)
 {
 	in_stream.close();
+	if(input_file != filename)
+		unlink(input_file.c_str());
+	for(size_t col_num = 0; col_num < columns.size(); col_num++)
+	{
+		if(!columns[col_num].spill_file.empty())
+			unlink(columns[col_num].spill_file.c_str());
+	}
+}
+
+/*
+Loads a file into a shared, read-only handle. Copies of the handle can be passed to other threads,
+which may all read the data at once, and the data is freed when the last copy is released.
+*/
+TextFileLoadHandle TextFileLoad::loadShared(string textfile, const TextFileLoadOptions& opts)
+{
+	return make_shared<const TextFileLoad>(textfile, opts);
 }
 
 
@@ -64,22 +327,104 @@ TextFileLoad::~TextFileLoad(void)
 // PRIVATE METHODS
 /////////////////////////////////////////////////////////////////////////////
 
+/*
+Sets the member properties and loads the file data. Shared by all constructors.
+*/
+void TextFileLoad::_init(string textfile, const TextFileLoadOptions& opts)
+{
+	//Set member properties
+	filename = textfile;
+	delimiter = opts.delimiter;
+	header_row = opts.header_row;
+	use_schema = !opts.schema.empty() || !opts.schema_by_name.empty();
+	encoding = opts.encoding;
+	fixed_fields = opts.fixed_width;
+	record_length = 0;
+
+	index_stride = 0;
+	index_rows = 0;
+	memory_budget = opts.memory_budget;
+	spill_directory = opts.spill_directory;
+	if(spill_directory.length() == 0)
+		spill_directory = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+	use_clock = 0;
+
+	//Seconds since the previous call, for the load timings
+	chrono::steady_clock::time_point phase_start = chrono::steady_clock::now();
+	auto phase_seconds = [&phase_start]()
+	{
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		double seconds = chrono::duration<double>(now - phase_start).count();
+		phase_start = now;
+		return seconds;
+	};
+
+	//Load file data
+	_openFile();
+	_getFieldNames();
+	timings.open_seconds = phase_seconds();
+	_selectRows(opts);
+	sampled_types = false;
+	if(use_schema)
+		_applySchema(opts);
+	else if(opts.infer_rows > 0)
+		_sampleFieldTypes(opts.infer_rows, opts.infer_stripes, opts.sample_seed);
+	else
+		_getFieldTypes();
+	_setFieldTypeNames();
+	timings.types_seconds = phase_seconds();
+	data_visited = false;
+	if(opts.visitor != NULL)
+		_visitData(*opts.visitor, opts.batch_rows);
+	else
+		_getData();
+	timings.parse_seconds = phase_seconds();
+
+	//_getData() only builds the requested index when it reads the whole file
+	if(opts.index_stride > 0 && row_index.empty())
+		buildRowIndex(opts.index_stride);
+
+	if(opts.compact && !data_visited)
+	{
+		for(int col_num = 0; col_num < field_count; col_num++)
+		{
+			_compactColumn(_residentColumn(col_num));
+			column_bytes[col_num] = _columnBytes(columns[col_num]);
+		}
+	}
+	timings.finish_seconds = phase_seconds();
+}
+
 /*
 Opens the input file stream and issues an error if the file fails to open.
+Determines the text encoding, and switches to a UTF-8 copy of the file if it is UTF-16. A file
+detected as UTF-8 is checked row by row as it is parsed.
 Detect what the end-of-line formatting is.
 */
 void TextFileLoad::_openFile(void)
 {
 	string full_row;
 	int next_pos;
-	in_stream.open(filename.c_str());
+	in_stream.open(filename.c_str(), ios::in | ios::binary);
 
 	if(!in_stream)
 	{
 		printf("\n\nERROR: file failed to open!\n\n");
 		exit(1);
 	}
-	
+
+	input_file = filename;
+	text_start = 0;
+	bool detect = (encoding == _ENC_AUTO);
+	encoding = _detectEncoding();
+	check_utf8 = (detect && encoding == _ENC_UTF8);
+	latin1_text = (encoding == _ENC_LATIN1);
+	utf8_rows = false;
+	if(encoding == _ENC_UTF16LE || encoding == _ENC_UTF16BE)
+		_transcodeFile();
+	in_stream.clear();
+	in_stream.seekg(text_start, ios::beg);
+
 	// Windows end-of-line files do not have a '\r'. This affects extraction of the data
 	// in _splitString. Set offset equal to 0 if there is no '\r' and one equal to 1 otherwise.
 	getline(in_stream, full_row);
@@ -87,9 +432,14 @@ void TextFileLoad::_openFile(void)
 	if (next_pos==-1) offset=0;
 	else offset = 1;
 	
-	// Reset stream pointer to beginning of file
+	// Record the file size, used to validate saved row indexes
 	in_stream.clear();
-	in_stream.seekg (0, ios::beg);	
+	in_stream.seekg (0, ios::end);
+	file_size = in_stream.tellg();
+
+	// Reset stream pointer to beginning of the text
+	in_stream.clear();
+	in_stream.seekg (text_start, ios::beg);
 }
 
 /*
@@ -105,780 +455,4084 @@ void TextFileLoad::_getFieldNames(void)
 		printf("\nFirst row is empty!\n");
 		exit(1);
 	}
+	if(check_utf8)
+		_checkEncoding(first_line);
 	field_names = _splitString(first_line, delimiter);
+	if(latin1_text)
+		_latin1Fields(field_names);
 	field_count = field_names.size();
+	data_start = text_start + (header_row ? (int64_t)first_line.length() + 1 : 0);
 	if(!header_row)
 	{
-		//There are no field names, so reset the ifstream pointer to the beginning of the file
+		//There are no field names, so reset the ifstream pointer to the beginning of the text
 		field_names.clear();
 		in_stream.clear();
-		in_stream.seekg(0,ios::beg);
-	}
-}
-
-/*
-Determines the variable type for each field based on all the data in each field. The type is
-chosen to be as restrictive as possible while making sure not to lose any information. Thus, a
-column of all 1's and 0's will be stored as boolean, but a column that has one million
-0's and one string will be stored as string.
-*/
-void TextFileLoad::_getFieldTypes(void)
-{
-	string tmp, datum;
-	vector<string> data, one_split_row;
-	_VT_TYPE type;
-
-	//Read in the entire dataset
-	while(!in_stream.eof())
-	{
-		getline( in_stream, tmp );
-		if(tmp.length()==0) //Skip empty lines
-			continue;
-		else
-			data.push_back(tmp);
+		in_stream.seekg(text_start,ios::beg);
 	}
 
-	//Methodically step through and determine the type for each column
-	for(int i = 0; i < field_count; i++)
+	//Fixed-width fields are named by the layout, and a header row is only skipped
+	if(!fixed_fields.empty())
 	{
-		//bool is most restrictive type, so that will be the default
-		type = _VT_BOOL;
-		for(int j = 0; j < data.size(); j++)
+		field_names.clear();
+		for(size_t i = 0; i < fixed_fields.size(); i++)
 		{
-			one_split_row = _splitString(data[j],delimiter);
-			datum = one_split_row[i];
-			switch(_getType(datum))
+			if(fixed_fields[i].start < 0 || fixed_fields[i].length <= 0)
 			{
-				case _VT_BOOL:
-					break;
-
-				case _VT_INT:
-					if(type==_VT_BOOL)
-						type = _VT_INT;
-					break;
-
-				case _VT_LONG:
-					if(type==_VT_BOOL || type==_VT_INT)
-						type = _VT_LONG;
-					break;
-
-				case _VT_DOUBLE:
-					if(type!=_VT_STRING)
-						type = _VT_DOUBLE;
-					break;
-
-				case _VT_STRING:
-					type = _VT_STRING;
+				printf("\nFixed-width field %s has an invalid position!\n", fixed_fields[i].name.c_str());
+				exit(1);
 			}
+			field_names.push_back(fixed_fields[i].name);
 		}
-		field_types.push_back(type);
+		field_count = field_names.size();
+		_getRecordLength();
 	}
 }
 
 /*
-Loads all the data into the vector of variants. It determines which variant property to store
-the data in according to the results of the previously called _getFieldTypes() method.
-Note: nulls are automatically stored as blank if column is string and 0 otherwise.
+Sets record_length if every data record of a fixed-width file appears to have the same length:
+the data must be a whole number of records as long as the first one. Records are then located by
+arithmetic, and _scanRecords() confirms the line break at the end of each record it reads.
 */
-void TextFileLoad::_getData(void)
+void TextFileLoad::_getRecordLength(void)
 {
-	string full_row;
-	vector<string> split_row;
-	vector<variant> row_data;
-
-	//Reading starts at line one or two of the file, depending on whether or not there is a header row
+	string first_record;
 	in_stream.clear();
-	in_stream.seekg (0, ios::beg);
-	if(header_row)
-		getline(in_stream, full_row);
-
-	//Read in the data, line by line.
-	row_count = 0;
-	while(!in_stream.eof())
+	in_stream.seekg(data_start, ios::beg);
+	record_length = 0;
+	if(getline(in_stream, first_record) && !in_stream.eof() && first_record.length() > 0)
 	{
-		getline(in_stream, full_row);
-		split_row = _splitString(full_row,delimiter);
-
-		//Skip empty lines
-		if(full_row.length()==0)
-			continue;
-
-		//Loop over the columns in the row and store the contents into a variant
-		for(int col_num = 0; col_num < split_row.size(); col_num++)
-		{
-			variant tmp;
-			switch(field_types[col_num])
-			{
-				case _VT_BOOL:
-					tmp.vt_type = _VT_BOOL;
-					tmp.vt_bool = atoi(split_row[col_num].c_str());
-					break;
-
-				case _VT_INT:
-					tmp.vt_type = _VT_INT;
-					tmp.vt_int = atoi(split_row[col_num].c_str());
-					break;
-
-				case _VT_LONG:
-					tmp.vt_type = _VT_LONG;
-					tmp.vt_long = atol(split_row[col_num].c_str());
-					break;
-
-				case _VT_DOUBLE:
-					tmp.vt_type = _VT_DOUBLE;
-					tmp.vt_double = atof(split_row[col_num].c_str());
-					break;
-
-				case _VT_STRING:
-					tmp.vt_type = _VT_STRING;
-					tmp.vt_string = split_row[col_num];
-			}
-			row_data.push_back(tmp);
-		}
-		data.push_back(row_data);
-		row_data.clear();
-		row_count++;
+		int64_t length = (int64_t)first_record.length() + 1;
+		if((file_size - data_start) % length == 0)
+			record_length = length;
 	}
+	in_stream.clear();
+	in_stream.seekg(data_start, ios::beg);
 }
 
 /*
-Tokenizes a string according and returns the tokens in a vector.
+Splits a row into its fields: by the delimiter, or by the fixed-width layout if there is one.
+The row is checked for UTF-8 validity first if need be, and Latin-1 fields are converted.
 */
-vector<string> TextFileLoad::_splitString(string str, char delimit)
+void TextFileLoad::_splitRow(const string& row, vector<string>& split_row)
 {
-	vector<string> results;
-	string temp;
-	int str_length;
-	int first_pos = 0;
-	int next_pos = (int)str.find(delimit); //returns -1 if nothing is found
-	
-	while(next_pos!=-1)
-	{
-		//Store the token
-		str_length = next_pos - first_pos;
-		temp = str.substr(first_pos,str_length);
-		results.push_back(temp);
-
-		//Find the next token, if any delimiters remain
-		first_pos = next_pos+1;
-		next_pos = (int)str.find(delimit,first_pos);
-	}
-
-	//Grab the final token in the string (or the only token, if there were no delimiters present)
-	// If a '/r' is present, we are under windows and need our offset to be 0 instead of 1
-	temp = str.substr(first_pos,str.length()-first_pos-offset);
-	results.push_back(temp);
-
-	return results;
+	if(check_utf8)
+		_checkEncoding(row);
+	if(fixed_fields.empty())
+		split_row = _splitString(row, delimiter);
+	else
+		_sliceFields(row.data(), row.length(), split_row);
+	if(latin1_text)
+		_latin1Fields(split_row);
 }
 
 /*
-Determines what type a particular string could be converted to.
+Cuts the fields of a fixed-width record of length len (any line break excluded) by their start
+and length, and trims the spaces that pad them. Fields past the end of the record are null.
 */
-int TextFileLoad::_getType(string str)
+void TextFileLoad::_sliceFields(const char* record, size_t len, vector<string>& split_row) const
 {
-	//Nulls could be anything, so let them be the most restrictive type (i.e., boolean)
-	if(str.length()==0)
-		return _VT_BOOL;
-
-	if(_trim(str)=="0" | _trim(str)=="1")
-		return _VT_BOOL;
-
-	else if(!_isDouble(_trim(str)))
-		return _VT_STRING;
-
-	else if(!_isLong(_trim(str)))
-		return _VT_DOUBLE;
-
-	else
+	if(len > 0 && record[len - 1] == '\r')
+		len--;
+	split_row.resize(fixed_fields.size());
+	for(size_t i = 0; i < fixed_fields.size(); i++)
 	{
-		long tmp_long = atol(str.c_str());
-		//If the long takes an absolute value of less than -32768, assume it can be an int
-		if(tmp_long < 32768 && tmp_long > -32768)
-			return _VT_INT;
-		else
-			return _VT_LONG;
+		size_t first = min((size_t)fixed_fields[i].start, len);
+		size_t last = min(first + (size_t)fixed_fields[i].length, len);
+		while(first < last && record[first] == ' ')
+			first++;
+		while(last > first && record[last - 1] == ' ')
+			last--;
+		split_row[i].assign(record + first, last - first);
 	}
 }
 
 /*
-Trims all beginning and ending spaces of a string.
+Returns true if the rows to load can be parsed in parallel: a fixed-width file of equal-length
+records, loaded whole and without a memory budget. Returns the number of threads in workers.
 */
-string TextFileLoad::_trim(string str)
+bool TextFileLoad::_parallelRecords(unsigned& workers) const
 {
-	string r=str.erase(str.find_last_not_of(" ")+1);
-	return r.erase(0,r.find_first_not_of(" "));
+	if(record_length <= 0 || memory_budget > 0 || row_ranges.size() != 1 || row_ranges[0].skip != 0 ||
+		row_ranges[0].count != -1 || row_ranges[0].offset != data_start)
+		return false;
+	workers = _workerCount((file_size - data_start) / record_length, 16384);
+	return workers > 1;
 }
 
 /*
-Determines whether the string is a valid double. This is needed because atof will work on invalid
-numbers, e.g. atof(3.23dfs) yields 3.23. We, however, want it to remain a string should that
-case arise. The only thing we want trimmed is spaces.
+Reads fixed-width records first to last-1 through a stream of its own and passes the fields of
+each one to visit. Safe to run on several threads at once. Returns false if a record does not
+end with a line break or holds one before its end (e.g. a blank line followed by a shorter one),
+i.e. the records do not all have the same length after all. Also returns false, and sets
+invalid_text, at the first record that is not valid UTF-8 while the file is being checked.
 */
-bool TextFileLoad::_isDouble(string str)
+bool TextFileLoad::_scanRecords(int64_t first, int64_t last, const function<void(vector<string>&)>& visit, char& invalid_text) const
 {
-	bool period_present = false; // only one period allowed per string
-	bool e_present = false;		 // only one 'e' (for scientific notation) allowed per string
-	int ok_negative_loc = 0;	 // negatives allowed at position 0 and position x+1, where x is position of 'e'
-	int ok_positive_loc = -1;	 // positives allowed at position x+1, where x is position of 'e'
-	str = _trim(str);
-
-	//Check each individual character
-	for(int i = 0; i<str.length(); i++)
+	ifstream records(input_file.c_str(), ios::in | ios::binary);
+	records.seekg(data_start + first * record_length, ios::beg);
+	int64_t block_records = max((int64_t)1, (int64_t)(1 << 20) / record_length);
+	vector<char> block(block_records * record_length);
+	vector<string> split_row;
+	for(int64_t rec = first; rec < last; rec += block_records)
 	{
-		char ch = str[i];
-
-		switch(ch) {
-			case '0':
-				break;
-			case '1':
-				break;
-			case '2':
-				break;
-			case '3':
-				break;
-			case '4':
-				break;
-			case '5':
-				break;
-			case '6':
-				break;
-			case '7':
-				break;
-			case '8':
-				break;
-			case '9':
-				break;
-			case '.':
-				if(period_present)
-					return false;
-				else
-					period_present = true;
-				break;
-			case 'e':
-				if(e_present)
-					return false;
-				else
-					e_present = true;
-					ok_negative_loc = i+1;
-					ok_positive_loc = i+1;
-				break;
-			case '-':
-				if( i != ok_negative_loc )
-					return false;
-				else
-					break;
-			case '+':
-				if( i != ok_positive_loc )
-					return false;
-				else
-					break;
-			default:
+		int64_t n = min(block_records, last - rec);
+		if(!records.read(&block[0], n * record_length))
+			return false;
+		for(int64_t i = 0; i < n; i++)
+		{
+			const char* record = &block[i * record_length];
+			if(record[record_length - 1] != '\n' || memchr(record, '\n', record_length - 1) != NULL)
+				return false;
+			if(check_utf8 && _validUtf8((const unsigned char*)record, record_length - 1) < (size_t)(record_length - 1))
+			{
+				invalid_text = 1;
 				return false;
+			}
+			_sliceFields(record, record_length - 1, split_row);
+			if(latin1_text)
+				_latin1Fields(split_row);
+			visit(split_row);
 		}
 	}
 	return true;
 }
 
 /*
-Determines whether the string is a valid long. This is needed because atol will work on invalid
-numbers, e.g. atol(3.23dfs) yields 3. We, however, want it to remain a string should that
-case arise. The only thing we want trimmed is spaces.
+Determines the variable type for each field based on all the data in each field. The type is
+chosen to be as restrictive as possible while making sure not to lose any information. Thus, a
+column of all 1's and 0's will be stored as boolean, but a column that has one million
+0's and one string will be stored as string.
 */
-bool TextFileLoad::_isLong(string str)
+void TextFileLoad::_getFieldTypes(void)
 {
-	str = _trim(str);
+	string tmp;
+	vector<string> one_split_row;
 
-	for(int i = 0; i<str.length(); i++)
+	//bool is most restrictive type, so that will be the default
+	field_types.assign(field_count, _VT_BOOL);
+	vector<char>& has_value = inferred_values; // Columns with a non-null value so far
+	has_value.assign(field_count, 0);
+
+	//Equal-length fixed-width records: each thread infers the types of a block of records, and the
+	//block types are then widened into each other
+	unsigned workers;
+	if(_parallelRecords(workers))
 	{
-		char ch = str[i];
-		switch(ch) {
-			case '0':
-				break;
-			case '1':
-				break;
-			case '2':
-				break;
-			case '3':
-				break;
-			case '4':
+		int64_t records = (file_size - data_start) / record_length;
+		vector< vector<_VT_TYPE> > block_types(workers, vector<_VT_TYPE>(field_count, _VT_BOOL));
+		vector< vector<char> > block_has_value(workers, vector<char>(field_count, 0));
+		vector<char> block_ok(workers, 0);
+		vector<char> block_invalid(workers, 0);
+		vector<thread> threads;
+		for(unsigned w = 0; w < workers; w++)
+		{
+			threads.push_back(thread([&, w]()
+			{
+				block_ok[w] = _scanRecords(records * w / workers, records * (w + 1) / workers, [&](vector<string>& split_row)
+				{
+					for(int i = 0; i < field_count; i++)
+					{
+						if(split_row[i].length() == 0)
+							continue;
+						_widenType(block_types[w][i], block_has_value[w][i], _getType(split_row[i]));
+						block_has_value[w][i] = 1;
+					}
+				}, block_invalid[w]);
+			}));
+		}
+		for(unsigned w = 0; w < workers; w++)
+			threads[w].join();
+		if(count(block_ok.begin(), block_ok.end(), 1) == (int)workers)
+		{
+			for(unsigned w = 0; w < workers; w++)
+			{
+				for(int i = 0; i < field_count; i++)
+				{
+					if(!block_has_value[w][i])
+						continue;
+					_widenType(field_types[i], has_value[i], block_types[w][i]);
+					has_value[i] = 1;
+				}
+			}
+			return;
+		}
+		if(count(block_invalid.begin(), block_invalid.end(), 1) > 0)
+		{
+			//The file is not UTF-8: infer the types again from its Latin-1 text
+			_useLatin1();
+			_getFieldTypes();
+			return;
+		}
+		record_length = 0; //Not all records have the same length, so read them one by one
+	}
+
+	//Step through the selected rows one at a time and widen the type of each column as needed
+	_rewindRows();
+	while(_nextRow(tmp))
+	{
+		_splitRow(tmp, one_split_row);
+		for(int i = 0; i < field_count && (size_t)i < one_split_row.size(); i++)
+		{
+			if(one_split_row[i].length() == 0)
+				continue;
+			_widenType(field_types[i], has_value[i], _getType(one_split_row[i]));
+			has_value[i] = 1;
+		}
+	}
+}
+
+/*
+Determines the variable type for each field like _getFieldTypes(), but from a sample of about
+infer_rows of the selected rows instead of all of them: the first rows, and, if the whole file is
+selected, stripes of consecutive rows that start at random points of the file. The rows left out
+are checked while loading, and promote their column if they do not fit its type.
+*/
+void TextFileLoad::_sampleFieldTypes(long infer_rows, int stripes, unsigned int seed)
+{
+	string tmp;
+	vector<string> one_split_row;
+	field_types.assign(field_count, _VT_BOOL);
+	inferred_values.assign(field_count, 0);
+
+	//Widens the types by the values of one row
+	auto sample_row = [&](const string& row)
+	{
+		_splitRow(row, one_split_row);
+		for(int i = 0; i < field_count && (size_t)i < one_split_row.size(); i++)
+		{
+			if(one_split_row[i].length() == 0)
+				continue;
+			_widenType(field_types[i], inferred_values[i], _getType(one_split_row[i]));
+			inferred_values[i] = 1;
+		}
+	};
+
+	//A file without data rows has nothing to sample
+	sampled_types = false;
+	if(file_size <= data_start)
+		return;
+
+	//Rows outside a selected range must not widen the types, so stripes need the whole file
+	if(row_ranges.size() != 1 || row_ranges[0].offset != data_start || row_ranges[0].skip != 0 || row_ranges[0].count != -1)
+		stripes = 0;
+	long head_rows = (stripes > 0) ? max(1L, infer_rows / 2) : infer_rows;
+
+	long rows = 0;
+	_rewindRows();
+	while(rows < head_rows && _nextRow(tmp))
+	{
+		sample_row(tmp);
+		rows++;
+	}
+	if(rows < head_rows)
+	{
+		//Every selected row has been seen, so the types are exact
+		return;
+	}
+	sampled_types = true;
+
+	//Each stripe starts at the first row after a random byte offset
+	long stripe_rows = (stripes > 0) ? (infer_rows - head_rows + stripes - 1) / stripes : 0;
+	mt19937_64 rng(seed);
+	uniform_int_distribution<int64_t> position(0, file_size - data_start - 1);
+	for(int s = 0; s < stripes; s++)
+	{
+		int64_t offset = data_start + position(rng);
+		in_stream.clear();
+		in_stream.seekg(offset, ios::beg);
+		getline(in_stream, tmp);
+		for(long r = 0; r < stripe_rows && getline(in_stream, tmp); )
+		{
+			if(tmp.length() == 0)
+				continue;
+			sample_row(tmp);
+			r++;
+		}
+	}
+	in_stream.clear();
+}
+
+/*
+Stores the names of the field types, as returned by getFieldTypes().
+*/
+void TextFileLoad::_setFieldTypeNames(void)
+{
+	string tmp;
+	field_type_names.clear();
+	for(size_t i = 0; i < field_types.size(); i++)
+	{
+		switch(field_types[i]) {
+			case _VT_BOOL:
+				tmp = "BOOLEAN";
 				break;
-			case '5':
+			case _VT_INT:
+				tmp = "INT";
 				break;
-			case '6':
+			case _VT_LONG:
+				tmp = "LONG";
 				break;
-			case '7':
+			case _VT_DOUBLE:
+				tmp = "DOUBLE";
 				break;
-			case '8':
+			case _VT_STRING:
+				tmp = "STRING";
 				break;
-			case '9':
+			case _VT_DATE:
+				tmp = "DATE";
 				break;
-			default:
-				return false;
+			case _VT_TIMESTAMP:
+				tmp = "TIMESTAMP";
 		}
+		field_type_names.push_back(tmp);
 	}
-	return true;
+	field_taken.assign(field_types.size(), false);
 }
 
 /*
-Capitalizes a string.
+Sets the field types from a user-supplied schema instead of inferring them from the data.
 */
-string TextFileLoad::_toUpper(string str)
+void TextFileLoad::_applySchema(const TextFileLoadOptions& opts)
 {
+	if(!opts.schema.empty())
+	{
+		if(opts.schema.size() != (size_t)field_count)
+		{
+			printf("\nSchema has %d types but the file has %ld columns!\n", (int)opts.schema.size(), field_count);
+			exit(1);
+		}
+		field_types = opts.schema;
+		return;
+	}
 
-	for(int i = 0; i<str.length(); i++)
+	if(!header_row && fixed_fields.empty())
 	{
-		str[i] = toupper(str[i]);
+		printf("\nSchema by column name requires a header row!\n");
+		exit(1);
 	}
-	return str;
+
+	//Columns that are not named in the schema can hold anything, so load them as strings
+	field_types.assign(field_count, _VT_STRING);
+	for(map<string, _VT_TYPE>::const_iterator it = opts.schema_by_name.begin(); it != opts.schema_by_name.end(); ++it)
+		field_types[_getColNum(it->first, false)] = it->second;
 }
 
 /*
-Returns the column number for a given column name. If column not found, program exits.
+Determines which rows will be loaded and stores them as runs in row_ranges. A saved row index
+is loaded if one is named; otherwise an index is only built if it is needed to draw a sample.
 */
-int TextFileLoad::_getColNum(string column_name, bool case_sensitive)
+void TextFileLoad::_selectRows(const TextFileLoadOptions& opts)
 {
-	if(!case_sensitive)
-		column_name = _toUpper(column_name);
+	if(opts.index_file.empty() || !_loadRowIndex(opts.index_file))
+		index_stride = opts.index_stride;
 
-	//Determine the relevant column number
-	for (int col_num = 0; col_num < field_count; col_num++)
+	row_range range;
+	range.offset = data_start;
+	range.skip = 0;
+	range.count = opts.max_rows;
+	range.row = 0;
+	row_ranges.clear();
+
+	if(opts.sample_rows > 0)
 	{
-		string col_name;
-		if(case_sensitive)
-			col_name = field_names[col_num];
-		else
-			col_name = _toUpper(field_names[col_num]);
+		//Sampling needs the offsets of all rows, so scan for them if no index was saved
+		if(row_index.empty())
+			buildRowIndex(256);
 
-		if (column_name == col_name)
+		//Floyd's algorithm draws sample_rows distinct rows out of index_rows
+		long sample_size = (opts.sample_rows < index_rows) ? opts.sample_rows : index_rows;
+		map<int64_t, bool> sample;
+		mt19937_64 rng(opts.sample_seed);
+		for(int64_t j = index_rows - sample_size; j < index_rows; j++)
 		{
-			return col_num;
+			int64_t r = uniform_int_distribution<int64_t>(0, j)(rng);
+			if(sample.count(r))
+				r = j;
+			sample[r] = true;
+		}
+		for(map<int64_t, bool>::iterator it = sample.begin(); it != sample.end(); ++it)
+		{
+			range.row = it->first;
+			range.offset = row_index[it->first / index_stride];
+			range.skip = it->first % index_stride;
+			range.count = 1;
+			row_ranges.push_back(range);
 		}
+		return;
 	}
-	printf("\nColumn name %s does not exist!\n", column_name.c_str());
-	exit(1);
+
+	if(opts.first_row < 0 && !row_index.empty())
+	{
+		//With an index the row count is known, so the tail is an ordinary range
+		range.row = index_rows + opts.first_row;
+		if(range.row < 0)
+			range.row = 0;
+	}
+	else if(opts.first_row < 0)
+	{
+		//Without an index, find where the tail starts by scanning backwards from the end of the file
+		range.offset = _findTailOffset(-opts.first_row);
+		range.row = -1;
+	}
+	else
+		range.row = opts.first_row;
+
+	if(range.row > 0 && !row_index.empty())
+	{
+		int64_t block = range.row / index_stride;
+		if(block >= (int64_t)row_index.size())
+			block = row_index.size() - 1;
+		range.offset = row_index[block];
+		range.skip = range.row - block * index_stride;
+	}
+	else if(range.row > 0)
+		range.skip = range.row;
+
+	row_ranges.push_back(range);
 }
 
+/*
+Positions the input stream at the start of the first selected row.
+*/
+void TextFileLoad::_rewindRows(void)
+{
+	current_row = -1;
+	utf8_rows = false;
+	range_pos = 0;
+	range_remaining = 0;
+	if(!row_ranges.empty())
+		_seekRange(row_ranges[0]);
+}
 
-/////////////////////////////////////////////////////////////////////////////
-// PUBLIC METHODS
-/////////////////////////////////////////////////////////////////////////////
+/*
+Moves the input stream to the first row of a run. If the run starts a short distance after the
+current row, the rows in between are skipped instead of seeking back to the indexed offset.
+*/
+void TextFileLoad::_seekRange(const row_range& range)
+{
+	string skipped;
+	long skip = range.skip;
+
+	if(range.row >= 0 && current_row >= 0 && range.row >= current_row && range.row - current_row <= range.skip)
+		skip = range.row - current_row;
+	else
+	{
+		in_stream.clear();
+		in_stream.seekg(range.offset, ios::beg);
+		stream_pos = range.offset;
+	}
+
+	while(skip > 0 && getline(in_stream, skipped))
+	{
+		stream_pos += skipped.length() + 1;
+		if(skipped.length() > 0)
+			skip--;
+	}
 
+	current_row = range.row;
+	range_remaining = range.count;
+}
 
 /*
-Returns a vector of strings containing the field names for the columns.
+Reads the next selected row into row, skipping empty lines. Returns false when there are no
+selected rows left. The byte offset of the row is stored in last_row_offset.
 */
-vector<string> TextFileLoad::getFieldNames(void)
+bool TextFileLoad::_nextRow(string& row)
 {
-	return field_names;
+	while(true)
+	{
+		//Move on to the next run once the current one is exhausted
+		if(range_remaining == 0)
+		{
+			if(++range_pos >= row_ranges.size())
+				return false;
+			_seekRange(row_ranges[range_pos]);
+			continue;
+		}
+
+		last_row_offset = stream_pos;
+		if(!getline(in_stream, row))
+			return false;
+		stream_pos += row.length() + 1;
+
+		//Skip empty lines
+		if(row.length()==0)
+			continue;
+
+		if(range_remaining > 0)
+			range_remaining--;
+		if(current_row >= 0)
+			current_row++;
+		return true;
+	}
 }
 
 /*
-Returns a vector of strings containing the field types for the columns.
+Returns the byte offset of the first of the last rows rows of the file, found by reading the
+file backwards in blocks. Returns the start of the data if the file has fewer rows.
 */
-vector<string> TextFileLoad::getFieldTypes(void)
+int64_t TextFileLoad::_findTailOffset(long rows)
 {
-	vector<string> types;
-	string tmp;
-	for(int i = 0; i < field_types.size(); i++)
+	const int64_t block_size = 65536;
+	vector<char> block(block_size);
+	int64_t pos = file_size;
+	bool line_has_content = false;
+	long found = 0;
+
+	while(pos > data_start)
 	{
-		switch(field_types[i]) {
-			case _VT_BOOL:
-				tmp = "BOOLEAN";
-				break;
-			case _VT_INT:
-				tmp = "INT";
-				break;
-			case _VT_LONG:
-				tmp = "LONG";
-				break;
-			case _VT_DOUBLE:
-				tmp = "DOUBLE";
-				break;
-			case _VT_STRING:
-				tmp = "STRING";
+		int64_t len = (pos - data_start < block_size) ? pos - data_start : block_size;
+		pos -= len;
+		in_stream.clear();
+		in_stream.seekg(pos, ios::beg);
+		in_stream.read(&block[0], len);
+
+		for(int64_t i = len - 1; i >= 0; i--)
+		{
+			if(block[i] != '\n')
+				line_has_content = true;
+			else if(line_has_content)
+			{
+				//A non-empty row starts right after this newline
+				line_has_content = false;
+				if(++found == rows)
+					return pos + i + 1;
+			}
 		}
-		types.push_back(tmp);
 	}
-	return types;
+	return data_start;
 }
 
 /*
-Returns true if the string parameter matches the name of an existing field. Default value for
-case_sensitive parameter is false.
+Fills the header of a saved row index from the text file and the index: file size, modification
+time, data start, stride, rows, and a hash of the line break and first bytes at up to 64 indexed
+row starts spread over the file.
 */
-bool TextFileLoad::existsFieldName(string name, bool case_sensitive)
+void TextFileLoad::_rowIndexHeader(int64_t header[6])
 {
-	if(!case_sensitive)
-		name = _toUpper(name);
+	struct stat file_stat;
+	header[0] = file_size;
+	header[1] = (stat(filename.c_str(), &file_stat) == 0) ? (int64_t)file_stat.st_mtime : 0;
+	header[2] = data_start;
+	header[3] = index_stride;
+	header[4] = index_rows;
 
-	for(int i = 0; i < field_names.size(); i++)
+	//FNV-1a over 8 bytes from just before each sampled row start
+	uint64_t hash = 14695981039346656037ULL;
+	size_t samples = (row_index.size() < 64) ? row_index.size() : 64;
+	for(size_t s = 0; s < samples; s++)
 	{
-		if(case_sensitive && name==field_names[i])
-			return true;
-		else if(name==_toUpper(field_names[i]))
-			return true;
+		int64_t offset = row_index[s * row_index.size() / samples];
+		char bytes[8] = {0};
+		in_stream.clear();
+		in_stream.seekg((offset > 0) ? offset - 1 : 0, ios::beg);
+		in_stream.read(bytes, sizeof(bytes));
+		for(size_t i = 0; i < sizeof(bytes); i++)
+			hash = (hash ^ (unsigned char)bytes[i]) * 1099511628211ULL;
 	}
-	return false;
+	in_stream.clear();
+	header[5] = (int64_t)hash;
+}
+
+/*
+Loads a row index saved by saveRowIndex(). Returns false, leaving the index empty, if the file
+does not exist or was saved for a different version of the text file.
+*/
+bool TextFileLoad::_loadRowIndex(string index_file)
+{
+	ifstream idx_stream(index_file.c_str(), ios::in | ios::binary);
+	if(!idx_stream)
+	{
+		printf("\nWARNING: row index %s does not exist and was ignored.\n", index_file.c_str());
+		return false;
+	}
+
+	char magic[8];
+	int64_t saved[6]; //see _rowIndexHeader
+	idx_stream.read(magic, sizeof(magic));
+	idx_stream.read((char*)saved, sizeof(saved));
+	bool valid = (idx_stream && string(magic, 7) == "TFLIDX2" && saved[0] == file_size && saved[2] == data_start && saved[3] > 0 && saved[4] >= 0);
+	if(valid)
+	{
+		index_stride = saved[3];
+		index_rows = saved[4];
+		row_index.resize((index_rows + index_stride - 1) / index_stride);
+		if(!row_index.empty())
+			idx_stream.read((char*)&row_index[0], row_index.size() * sizeof(int64_t));
+
+		//The file must not have changed since the index was saved
+		int64_t current[6];
+		_rowIndexHeader(current);
+		valid = idx_stream && equal(saved, saved + 6, current);
+	}
+	if(!valid)
+	{
+		printf("\nWARNING: row index %s does not match %s and was ignored.\n", index_file.c_str(), filename.c_str());
+		row_index.clear();
+		index_stride = 0;
+		index_rows = 0;
+		return false;
+	}
+	return true;
+}
+
+/*
+Sets up one empty column per field in the natural storage type of its field type in types, and
+returns the number of bytes per row that these take, not counting string contents. Compact mode
+may narrow the storage after loading.
+*/
+int64_t TextFileLoad::_initColumns(vector<column>& cols, const vector<_VT_TYPE>& types)
+{
+	cols.assign(field_count, column());
+	int64_t row_bytes = 0;
+	for(int col_num = 0; col_num < field_count; col_num++)
+	{
+		switch(types[col_num])
+		{
+			case _VT_BOOL:
+				cols[col_num].st_type = _ST_INT8;
+				row_bytes += sizeof(int8_t);
+				break;
+			case _VT_INT:
+				cols[col_num].st_type = _ST_INT32;
+				row_bytes += sizeof(int32_t);
+				break;
+			case _VT_LONG:
+				cols[col_num].st_type = _ST_INT64;
+				row_bytes += sizeof(int64_t);
+				break;
+			case _VT_DOUBLE:
+				cols[col_num].st_type = _ST_DOUBLE;
+				row_bytes += sizeof(double);
+				break;
+			case _VT_STRING:
+				cols[col_num].st_type = _ST_STRING;
+				row_bytes += sizeof(string);
+				break;
+			case _VT_DATE:
+				cols[col_num].st_type = _ST_INT32;
+				row_bytes += sizeof(int32_t);
+				break;
+			case _VT_TIMESTAMP:
+				cols[col_num].st_type = _ST_INT64;
+				row_bytes += sizeof(int64_t);
+		}
+	}
+	return row_bytes;
+}
+
+/*
+Returns the parse state at the start of a load: the inferred field types, with type checks if
+they were inferred from a sample of the rows.
+*/
+TextFileLoad::parse_state TextFileLoad::_newParseState(void)
+{
+	parse_state state;
+	state.types = field_types;
+	state.has_value = inferred_values;
+	state.has_value.resize(field_count, 1);
+	state.mismatches.assign(field_count, 0);
+	state.promotions.assign(field_count, 0);
+	state.text_rows.assign(field_count, 0);
+	state.rows = 0;
+	state.check_types = sampled_types;
+	return state;
+}
+
+/*
+Returns true if [first, last) holds nothing but spaces, i.e. is a null.
+*/
+static bool _isBlank(const char* first, const char* last)
+{
+	while(first < last && *first == ' ')
+		first++;
+	return first == last;
+}
+
+/*
+Converts [first, last), less surrounding spaces, to an integer. Returns false if the text is not
+an integer or does not fit in 64 bits. Blank text is a null, and converts to 0.
+*/
+static bool _parseInteger(const char* first, const char* last, int64_t& value)
+{
+	while(first < last && *first == ' ')
+		first++;
+	while(last > first && last[-1] == ' ')
+		last--;
+	value = 0;
+	if(first == last)
+		return true;
+	from_chars_result res = from_chars(first, last, value);
+	return res.ec == errc() && res.ptr == last;
+}
+
+/*
+Converts [first, last), less surrounding spaces, to a finite double. Returns false if the text
+is not a number. Blank text is a null, and converts to 0.
+*/
+static bool _parseDouble(const char* first, const char* last, double& value)
+{
+	while(first < last && *first == ' ')
+		first++;
+	while(last > first && last[-1] == ' ')
+		last--;
+	value = 0;
+	if(first == last)
+		return true;
+	from_chars_result res = from_chars(first, last, value);
+	return res.ec == errc() && res.ptr == last && isfinite(value);
+}
+
+/*
+Appends the values of one split row to the columns set up by _initColumns(), according to the
+field types of state, and counts values that do not fit a declared schema in the state. Missing
+trailing values are nulls. If the types were inferred from a sample, a value that does not fit
+its column's type first promotes the column (see _promoteColumn()). Returns the number of bytes
+of string contents appended.
+*/
+int64_t TextFileLoad::_appendRow(vector<string>& split_row, vector<column>& cols, parse_state& state)
+{
+	int64_t string_bytes = 0;
+	split_row.resize(field_count);
+
+	//Promote the columns before appending anything, so that all columns have the same number of
+	//rows if a spilled column has to be read back (which can spill others)
+	for(int col_num = 0; state.check_types && col_num < field_count; col_num++)
+	{
+		if(state.types[col_num] == _VT_STRING || split_row[col_num].length() == 0)
+			continue;
+		_VT_TYPE type = state.types[col_num];
+		_widenType(type, state.has_value[col_num], _getType(split_row[col_num]));
+		state.has_value[col_num] = 1;
+		if(type == state.types[col_num])
+			continue;
+
+		if(!cols[col_num].spill_file.empty())
+			_residentColumn(col_num);
+		_promoteColumn(cols[col_num], state.types[col_num], type);
+		if(type == _VT_STRING)
+			state.text_rows[col_num] = state.rows;
+		state.types[col_num] = type;
+		state.promotions[col_num]++;
+	}
+
+	//Each value is converted once; with a declared schema, a value the conversion does not accept
+	//exactly (or that is out of the range of the column's storage) is stored as null and counted.
+	//Inferred types hold all their values, so there a failed conversion falls back to atoi/atof.
+	for(int col_num = 0; col_num < field_count; col_num++)
+	{
+		const string& field = split_row[col_num];
+		const char* first = field.data();
+		const char* last = first + field.length();
+		column& col = cols[col_num];
+		bool fits = true;
+		switch(state.types[col_num])
+		{
+			case _VT_BOOL:
+			{
+				int64_t value = 0;
+				fits = _parseInteger(first, last, value) && (value == 0 || value == 1);
+				col.st_int8.push_back(fits ? value != 0 : !use_schema && atoi(first) != 0);
+				break;
+			}
+
+			case _VT_INT:
+			{
+				int64_t value = 0;
+				fits = _parseInteger(first, last, value) && value >= INT32_MIN && value <= INT32_MAX;
+				col.st_int32.push_back(fits ? (int32_t)value : use_schema ? 0 : atoi(first));
+				break;
+			}
+
+			case _VT_LONG:
+			{
+				int64_t value = 0;
+				fits = _parseInteger(first, last, value);
+				col.st_int64.push_back(fits ? value : use_schema ? 0 : atol(first));
+				break;
+			}
+
+			case _VT_DOUBLE:
+			{
+				double value = 0;
+				fits = _parseDouble(first, last, value);
+				col.st_double.push_back(fits ? value : use_schema ? 0 : atof(first));
+				break;
+			}
+
+			case _VT_STRING:
+				col.st_string.push_back(field);
+				string_bytes += field.length();
+				break;
+
+			case _VT_DATE:
+			{
+				int32_t days = 0;
+				fits = _isBlank(first, last) || _parseDate(first, last, days);
+				col.st_int32.push_back(days);
+				break;
+			}
+
+			case _VT_TIMESTAMP:
+			{
+				int64_t micros = 0;
+				int32_t days = 0;
+				fits = _isBlank(first, last) || _parseTimestamp(first, last, micros);
+				if(!fits && _parseDate(first, last, days))
+				{
+					micros = days * (int64_t)86400000000LL;
+					fits = true;
+				}
+				col.st_int64.push_back(micros);
+			}
+		}
+		if(!fits && use_schema)
+			state.mismatches[col_num]++;
+	}
+	state.rows++;
+	return string_bytes;
+}
+
+/*
+Converts the values of a column loaded as type from to the wider type to, in place. Integers
+widen exactly to wider integers or to doubles, and dates to timestamps at midnight. A column
+promoted to string gets blank placeholders, whose original text must then be re-read from the
+file (see parse_state::text_rows), so that the values match those of a load with full inference.
+*/
+void TextFileLoad::_promoteColumn(column& col, _VT_TYPE from, _VT_TYPE to)
+{
+	vector<int64_t> ints;
+	switch(col.st_type)
+	{
+		case _ST_INT8:
+			_convertValues(col.st_int8, ints);
+			break;
+		case _ST_INT32:
+			_convertValues(col.st_int32, ints);
+			break;
+		case _ST_INT64:
+			ints.swap(col.st_int64);
+			break;
+		default:
+			break;
+	}
+	size_t n = (col.st_type == _ST_DOUBLE) ? col.st_double.size() : ints.size();
+
+	column promoted;
+	promoted.spill_file = col.spill_file;
+	promoted.spill_rows = col.spill_rows;
+	switch(to)
+	{
+		case _VT_INT:
+			promoted.st_type = _ST_INT32;
+			_convertValues(ints, promoted.st_int32);
+			break;
+		case _VT_LONG:
+			promoted.st_type = _ST_INT64;
+			promoted.st_int64.swap(ints);
+			break;
+		case _VT_DOUBLE:
+			promoted.st_type = _ST_DOUBLE;
+			if(col.st_type == _ST_DOUBLE)
+				promoted.st_double.swap(col.st_double);
+			else
+				_convertValues(ints, promoted.st_double);
+			break;
+		case _VT_DATE:
+			promoted.st_type = _ST_INT32;
+			_convertValues(ints, promoted.st_int32);
+			break;
+		case _VT_TIMESTAMP:
+			promoted.st_type = _ST_INT64;
+			promoted.st_int64.swap(ints);
+			if(from == _VT_DATE)
+			{
+				for(size_t i = 0; i < n; i++)
+					promoted.st_int64[i] *= (int64_t)86400000000LL;
+			}
+			break;
+		case _VT_STRING:
+			promoted.st_type = _ST_STRING;
+			promoted.st_string.resize(n);
+			break;
+		default:
+			promoted.st_type = col.st_type;
+	}
+	swap(col, promoted);
+}
+
+/*
+Re-reads the first text_rows[col_num] selected rows of the file into each column promoted to
+string after those rows were loaded (see _restoreRow()). The columns are read back first in
+memory budget mode, and their size is updated afterwards.
+*/
+void TextFileLoad::_restoreText(const vector<long>& text_rows)
+{
+	long rows = *max_element(text_rows.begin(), text_rows.end());
+	if(rows == 0)
+		return;
+	for(int col_num = 0; col_num < field_count; col_num++)
+	{
+		if(text_rows[col_num] > 0)
+			_residentColumn(col_num);
+	}
+
+	string full_row;
+	vector<string> split_row;
+	_rewindRows();
+	for(long row = 0; row < rows && _nextRow(full_row); row++)
+	{
+		_splitRow(full_row, split_row);
+		_restoreRow(columns, text_rows, row, split_row);
+	}
+	for(int col_num = 0; col_num < field_count && memory_budget > 0; col_num++)
+	{
+		if(text_rows[col_num] > 0)
+			column_bytes[col_num] = _columnBytes(columns[col_num]);
+	}
+}
+
+/*
+Puts the text of a row (numbered within cols) back into the columns that were promoted to string
+after it was loaded, which hold a blank placeholder for it: those with row < text_rows.
+*/
+void TextFileLoad::_restoreRow(vector<column>& cols, const vector<long>& text_rows, long row, vector<string>& split_row)
+{
+	split_row.resize(field_count);
+	for(int col_num = 0; col_num < field_count; col_num++)
+	{
+		if(row < text_rows[col_num])
+			cols[col_num].st_string[row].swap(split_row[col_num]);
+	}
+}
+
+/*
+Makes the field types, mismatch counts and promotion counts of a finished load those of state.
+*/
+void TextFileLoad::_finishParse(const parse_state& state)
+{
+	field_types = state.types;
+	type_mismatches = state.mismatches;
+	type_promotions = state.promotions;
+	_setFieldTypeNames();
+}
+
+/*
+Prints a warning for each column with values that did not fit the declared schema.
+*/
+void TextFileLoad::_reportMismatches(void)
+{
+	for(int col_num = 0; col_num < field_count; col_num++)
+	{
+		if(type_mismatches[col_num] > 0 && header_row)
+			printf("\nWARNING: %ld value(s) in column %s did not fit the declared type and were stored as null.\n",
+				type_mismatches[col_num], field_names[col_num].c_str());
+		else if(type_mismatches[col_num] > 0)
+			printf("\nWARNING: %ld value(s) in column %d did not fit the declared type and were stored as null.\n",
+				type_mismatches[col_num], col_num+1);
+	}
+}
+
+/*
+Loads all the data into the columns. It determines which storage type to use for each column
+according to the results of the previously called _getFieldTypes() method.
+Note: nulls are automatically stored as blank if column is string and 0 otherwise.
+If the user declared a schema, values that do not fit their declared type are stored as nulls
+and counted in type_mismatches.
+*/
+void TextFileLoad::_getData(void)
+{
+	string full_row;
+	vector<string> split_row;
+	column_bytes.assign(field_count, 0);
+	column_last_used.assign(field_count, 0);
+	int64_t load_bytes = 0; //Bytes loaded since the last spill, in memory budget mode
+	int64_t row_bytes = _initColumns(columns, field_types);
+	parse_state state = _newParseState();
+
+	//If requested, record the offset of every index_stride-th row while reading the whole file
+	long stride = 0;
+	if(row_ranges.size() == 1 && row_ranges[0].skip == 0 && row_ranges[0].count == -1 && row_index.empty())
+		stride = index_stride;
+
+	//Equal-length fixed-width records are parsed in parallel blocks, which are then joined in order
+	unsigned workers;
+	if(_parallelRecords(workers) && _getDataParallel(workers))
+	{
+		if(stride > 0)
+		{
+			for(int64_t row = 0; row < row_count; row += stride)
+				row_index.push_back(data_start + row * record_length);
+			index_rows = row_count;
+		}
+		_reportMismatches();
+		return;
+	}
+
+	//Read in the selected rows, line by line.
+	row_count = 0;
+	_rewindRows();
+	while(_nextRow(full_row))
+	{
+		if(stride > 0 && row_count % stride == 0)
+			row_index.push_back(last_row_offset);
+
+		_splitRow(full_row, split_row);
+		load_bytes += _appendRow(split_row, columns, state);
+		row_count++;
+
+		//Over budget: move the rows loaded so far to the spill files
+		if(memory_budget > 0)
+		{
+			load_bytes += row_bytes;
+			if(load_bytes > memory_budget)
+			{
+				for(int col_num = 0; col_num < field_count; col_num++)
+					_spillColumn(col_num);
+				load_bytes = 0;
+			}
+		}
+	}
+
+	//Re-read the text of the rows loaded before their column was promoted to string. In memory
+	//budget mode, reading one column back can spill another, so each column gets a pass of its own.
+	if(memory_budget <= 0)
+		_restoreText(state.text_rows);
+	else
+	{
+		for(int col_num = 0; col_num < field_count; col_num++)
+		{
+			vector<long> text_rows(field_count, 0);
+			text_rows[col_num] = state.text_rows[col_num];
+			_restoreText(text_rows);
+		}
+	}
+	for(int col_num = 0; col_num < field_count; col_num++)
+	{
+		if(state.types[col_num] == _VT_BOOL)
+			_packBits(columns[col_num]);
+		column_bytes[col_num] = _columnBytes(columns[col_num]);
+	}
+	if(stride > 0)
+		index_rows = row_count;
+
+	_finishParse(state);
+	_reportMismatches();
+}
+
+/*
+Loads equal-length fixed-width records on several threads. Each thread parses a contiguous block
+of records into columns of its own, and the blocks are then appended to the columns in order.
+Returns false, loading nothing, if the records turn out not to have equal lengths.
+*/
+bool TextFileLoad::_getDataParallel(unsigned workers)
+{
+	int64_t records = (file_size - data_start) / record_length;
+	vector< vector<column> > block_columns(workers);
+	vector<parse_state> block_states(workers, _newParseState());
+	vector<char> block_ok(workers, 0);
+	vector<char> block_invalid(workers, 0);
+	vector<thread> threads;
+	for(unsigned w = 0; w < workers; w++)
+	{
+		threads.push_back(thread([&, w]()
+		{
+			_initColumns(block_columns[w], field_types);
+			block_ok[w] = _scanRecords(records * w / workers, records * (w + 1) / workers, [&](vector<string>& split_row)
+			{
+				_appendRow(split_row, block_columns[w], block_states[w]);
+			}, block_invalid[w]);
+		}));
+	}
+	for(unsigned w = 0; w < workers; w++)
+		threads[w].join();
+	if(count(block_ok.begin(), block_ok.end(), 1) != (int)workers)
+	{
+		if(count(block_invalid.begin(), block_invalid.end(), 1) > 0)
+		{
+			//The file is not UTF-8: parse all the blocks again as Latin-1
+			_useLatin1();
+			return _getDataParallel(workers);
+		}
+		record_length = 0;
+		return false;
+	}
+
+	//Blocks may have promoted their columns differently: bring them all to the widest type
+	parse_state state = _newParseState();
+	for(unsigned w = 0; w < workers; w++)
+	{
+		for(int col_num = 0; col_num < field_count; col_num++)
+		{
+			if(block_states[w].has_value[col_num])
+				_widenType(state.types[col_num], state.has_value[col_num], block_states[w].types[col_num]);
+			state.has_value[col_num] |= block_states[w].has_value[col_num];
+			state.mismatches[col_num] += block_states[w].mismatches[col_num];
+			state.promotions[col_num] += block_states[w].promotions[col_num];
+		}
+	}
+	threads.clear();
+	for(unsigned w = 0; w < workers; w++)
+	{
+		threads.push_back(thread([&, w]()
+		{
+			parse_state& block = block_states[w];
+			for(int col_num = 0; col_num < field_count; col_num++)
+			{
+				if(block.types[col_num] == state.types[col_num])
+					continue;
+				_promoteColumn(block_columns[w][col_num], block.types[col_num], state.types[col_num]);
+				if(state.types[col_num] == _VT_STRING)
+					block.text_rows[col_num] = block.rows;
+			}
+
+			//Re-read the text of the rows loaded before their column was promoted to string
+			long text_rows = *max_element(block.text_rows.begin(), block.text_rows.end());
+			long row = 0;
+			char invalid_text = 0;
+			if(text_rows > 0)
+			{
+				_scanRecords(records * w / workers, records * w / workers + text_rows, [&](vector<string>& split_row)
+				{
+					_restoreRow(block_columns[w], block.text_rows, row++, split_row);
+				}, invalid_text);
+			}
+		}));
+	}
+	for(unsigned w = 0; w < workers; w++)
+	{
+		threads[w].join();
+		for(int col_num = 0; col_num < field_count; col_num++)
+		{
+			if(block_states[w].types[col_num] != state.types[col_num])
+				state.promotions[col_num]++;
+		}
+	}
+
+	_initColumns(columns, state.types);
+	for(unsigned w = 0; w < workers; w++)
+	{
+		for(int col_num = 0; col_num < field_count; col_num++)
+			_appendColumn(columns[col_num], block_columns[w][col_num]);
+	}
+	for(int col_num = 0; col_num < field_count; col_num++)
+	{
+		if(state.types[col_num] == _VT_BOOL)
+			_packBits(columns[col_num]);
+		column_bytes[col_num] = _columnBytes(columns[col_num]);
+	}
+	row_count = records;
+	_finishParse(state);
+	return true;
+}
+
+/*
+Passes the selected rows to a visitor in batches of up to batch_rows rows instead of storing
+them. The values are parsed exactly as by _getData(), into the columns of a row_batch.
+
+Two batches are used in turn: a parser thread fills one while the calling thread passes the other
+to the visitor, so parsing overlaps with the visitor's work. A batch is cleared and refilled (its
+vectors keep their capacity) only after the visitor has returned from it. If the visitor throws,
+the parser thread is stopped and the exception is passed on.
+A column promoted while a batch is filled is promoted within that batch only; later batches start
+out with the promoted type.
+*/
+void TextFileLoad::_visitData(TextFileLoadVisitor& visitor, long batch_rows)
+{
+	column_bytes.assign(field_count, 0);
+	column_last_used.assign(field_count, 0);
+	_initColumns(columns, field_types);
+	parse_state state = _newParseState();
+	if(batch_rows <= 0)
+		batch_rows = 65536;
+
+	//If requested, record the offset of every index_stride-th row while reading the whole file
+	long stride = 0;
+	if(row_ranges.size() == 1 && row_ranges[0].skip == 0 && row_ranges[0].count == -1 && row_index.empty())
+		stride = index_stride;
+
+	row_batch batches[2];
+	bool filled[2] = {false, false};
+	long batch_count = -1; //Set by the parser thread once it has filled the last batch
+	bool stop = false;
+	mutex batch_mutex;
+	condition_variable batch_ready;
+
+	row_count = 0;
+	_rewindRows();
+	thread parser([&]()
+	{
+		string full_row;
+		vector<string> split_row;
+		vector<string> batch_text; //Text of the batch's rows, for columns promoted to string
+		for(long b = 0; ; b++)
+		{
+			row_batch& batch = batches[b % 2];
+			{
+				unique_lock<mutex> lock(batch_mutex);
+				batch_ready.wait(lock, [&]() { return !filled[b % 2] || stop; });
+				if(stop)
+					return;
+			}
+
+			if(batch.field_types != state.types)
+			{
+				_initColumns(batch.columns, state.types);
+				batch.field_types = state.types;
+			}
+			for(int col_num = 0; col_num < field_count; col_num++)
+			{
+				column& col = batch.columns[col_num];
+				col.st_int8.clear();
+				col.st_int32.clear();
+				col.st_int64.clear();
+				col.st_double.clear();
+				col.st_string.clear();
+			}
+			batch.first_row = row_count;
+			batch.row_count = 0;
+			while(batch.row_count < batch_rows && _nextRow(full_row))
+			{
+				if(stride > 0 && row_count % stride == 0)
+					row_index.push_back(last_row_offset);
+				_splitRow(full_row, split_row);
+				_appendRow(split_row, batch.columns, state);
+				if(state.check_types)
+				{
+					if(batch_text.size() <= (size_t)batch.row_count)
+						batch_text.resize(batch.row_count + 1);
+					batch_text[batch.row_count].swap(full_row);
+				}
+				batch.row_count++;
+				row_count++;
+			}
+
+			//Put back the text of the batch's rows loaded before their column was promoted to string
+			if(batch.field_types != state.types)
+			{
+				long text_rows = 0;
+				for(int col_num = 0; col_num < field_count; col_num++)
+				{
+					if(state.text_rows[col_num] > 0)
+						state.text_rows[col_num] -= batch.first_row;
+					text_rows = max(text_rows, state.text_rows[col_num]);
+				}
+				for(long row = 0; row < text_rows; row++)
+				{
+					_splitRow(batch_text[row], split_row);
+					_restoreRow(batch.columns, state.text_rows, row, split_row);
+				}
+				state.text_rows.assign(field_count, 0);
+				batch.field_types = state.types;
+			}
+
+			bool last = (batch.row_count < batch_rows);
+			{
+				lock_guard<mutex> lock(batch_mutex);
+				filled[b % 2] = true;
+				if(last)
+					batch_count = b + 1;
+			}
+			batch_ready.notify_all();
+			if(last)
+				return;
+		}
+	});
+
+	try
+	{
+		visitor.visitFields(field_names, field_type_names);
+		for(long b = 0; ; b++)
+		{
+			{
+				unique_lock<mutex> lock(batch_mutex);
+				batch_ready.wait(lock, [&]() { return filled[b % 2]; });
+			}
+			if(batches[b % 2].row_count > 0)
+				visitor.visitBatch(batches[b % 2]);
+			{
+				lock_guard<mutex> lock(batch_mutex);
+				filled[b % 2] = false;
+				if(b + 1 == batch_count)
+					break;
+			}
+			batch_ready.notify_all();
+		}
+	}
+	catch(...)
+	{
+		{
+			lock_guard<mutex> lock(batch_mutex);
+			stop = true;
+		}
+		batch_ready.notify_all();
+		parser.join();
+		throw;
+	}
+	parser.join();
+
+	if(stride > 0)
+		index_rows = row_count;
+	data_visited = true;
+	_finishParse(state);
+	_reportMismatches();
+}
+
+/*
+Narrows the storage of a loaded column to the smallest type that holds every value exactly.
+Bools are packed into bits, integers (and doubles that are all whole numbers) are stored in the
+narrowest of int8/int16/int32/int64 that spans their observed range, and other doubles are stored
+as floats if they all survive the round trip.
+*/
+void TextFileLoad::_compactColumn(column& col)
+{
+	//Doubles that all hold whole numbers are narrowed like integers. -0.0 is not, as an integer
+	//would lose its sign.
+	bool integral = (col.st_type == _ST_INT8 || col.st_type == _ST_INT32 || col.st_type == _ST_INT64);
+	if(col.st_type == _ST_DOUBLE)
+	{
+		integral = true;
+		for(size_t i = 0; i < col.st_double.size() && integral; i++)
+		{
+			double value = col.st_double[i];
+			integral = (value > -9007199254740992.0 && value < 9007199254740992.0 && value == (double)(int64_t)value && !(value == 0 && signbit(value)));
+		}
+	}
+
+	if(integral)
+	{
+		vector<int64_t> values;
+		if(col.st_type == _ST_INT8)
+			_convertValues(col.st_int8, values);
+		else if(col.st_type == _ST_INT32)
+			_convertValues(col.st_int32, values);
+		else if(col.st_type == _ST_INT64)
+			values.swap(col.st_int64);
+		else
+			_convertValues(col.st_double, values);
+
+		int64_t min_value = 0, max_value = 0;
+		for(size_t i = 0; i < values.size(); i++)
+		{
+			if(values[i] < min_value) min_value = values[i];
+			if(values[i] > max_value) max_value = values[i];
+		}
+
+		vector<int8_t>().swap(col.st_int8);
+		vector<int32_t>().swap(col.st_int32);
+		vector<double>().swap(col.st_double);
+		if(min_value >= 0 && max_value <= 1)
+		{
+			col.st_type = _ST_BIT;
+			col.st_bit.assign((values.size() + 63) / 64, 0);
+			for(size_t i = 0; i < values.size(); i++)
+				col.st_bit[i / 64] |= (uint64_t)(values[i] != 0) << (i % 64);
+		}
+		else if(min_value >= INT8_MIN && max_value <= INT8_MAX)
+		{
+			col.st_type = _ST_INT8;
+			_convertValues(values, col.st_int8);
+		}
+		else if(min_value >= INT16_MIN && max_value <= INT16_MAX)
+		{
+			col.st_type = _ST_INT16;
+			_convertValues(values, col.st_int16);
+		}
+		else if(min_value >= INT32_MIN && max_value <= INT32_MAX)
+		{
+			col.st_type = _ST_INT32;
+			_convertValues(values, col.st_int32);
+		}
+		else
+		{
+			col.st_type = _ST_INT64;
+			col.st_int64.swap(values);
+		}
+	}
+	else if(col.st_type == _ST_DOUBLE)
+	{
+		for(size_t i = 0; i < col.st_double.size(); i++)
+		{
+			if((double)(float)col.st_double[i] != col.st_double[i])
+				return;
+		}
+		col.st_type = _ST_FLOAT;
+		_convertValues(col.st_double, col.st_float);
+		vector<double>().swap(col.st_double);
+	}
+
+	//Release any spare capacity left over from loading
+	vector<int8_t>(col.st_int8).swap(col.st_int8);
+	vector<int16_t>(col.st_int16).swap(col.st_int16);
+	vector<int32_t>(col.st_int32).swap(col.st_int32);
+	vector<int64_t>(col.st_int64).swap(col.st_int64);
+	vector<float>(col.st_float).swap(col.st_float);
+}
+
+/*
+Tokenizes a string according and returns the tokens in a vector.
+*/
+vector<string> TextFileLoad::_splitString(string str, char delimit)
+{
+	vector<string> results;
+	string temp;
+	int str_length;
+	int first_pos = 0;
+	int next_pos = (int)str.find(delimit); //returns -1 if nothing is found
+	
+	while(next_pos!=-1)
+	{
+		//Store the token
+		str_length = next_pos - first_pos;
+		temp = str.substr(first_pos,str_length);
+		results.push_back(temp);
+
+		//Find the next token, if any delimiters remain
+		first_pos = next_pos+1;
+		next_pos = (int)str.find(delimit,first_pos);
+	}
+
+	//Grab the final token in the string (or the only token, if there were no delimiters present)
+	// If a '/r' is present, we are under windows and need our offset to be 0 instead of 1
+	temp = str.substr(first_pos,str.length()-first_pos-offset);
+	results.push_back(temp);
+
+	return results;
+}
+
+/*
+Determines what type a particular string could be converted to.
+*/
+int TextFileLoad::_getType(string str)
+{
+	//Nulls could be anything, so let them be the most restrictive type (i.e., boolean)
+	if(str.length()==0)
+		return _VT_BOOL;
+
+	if(_trim(str)=="0" | _trim(str)=="1")
+		return _VT_BOOL;
+
+	else if(!_isDouble(_trim(str)))
+	{
+		int32_t days;
+		int64_t micros;
+		if(_parseDate(str.data(), str.data() + str.length(), days))
+			return _VT_DATE;
+		if(_parseTimestamp(str.data(), str.data() + str.length(), micros))
+			return _VT_TIMESTAMP;
+		return _VT_STRING;
+	}
+
+	else if(!_isLong(_trim(str)))
+		return _VT_DOUBLE;
+
+	else
+	{
+		long tmp_long = atol(str.c_str());
+		//If the long takes an absolute value of less than -32768, assume it can be an int
+		if(tmp_long < 32768 && tmp_long > -32768)
+			return _VT_INT;
+		else
+			return _VT_LONG;
+	}
+}
+
+/*
+Trims all beginning and ending spaces of a string.
+*/
+string TextFileLoad::_trim(string str)
+{
+	string r=str.erase(str.find_last_not_of(" ")+1);
+	return r.erase(0,r.find_first_not_of(" "));
+}
+
+/*
+Determines whether the string is a valid double. This is needed because atof will work on invalid
+numbers, e.g. atof(3.23dfs) yields 3.23. We, however, want it to remain a string should that
+case arise. The only thing we want trimmed is spaces.
+*/
+bool TextFileLoad::_isDouble(string str)
+{
+	bool period_present = false; // only one period allowed per string
+	bool e_present = false;		 // only one 'e' (for scientific notation) allowed per string
+	int ok_negative_loc = 0;	 // negatives allowed at position 0 and position x+1, where x is position of 'e'
+	int ok_positive_loc = -1;	 // positives allowed at position x+1, where x is position of 'e'
+	str = _trim(str);
+
+	//Check each individual character
+	for(int i = 0; i<str.length(); i++)
+	{
+		char ch = str[i];
+
+		switch(ch) {
+			case '0':
+				break;
+			case '1':
+				break;
+			case '2':
+				break;
+			case '3':
+				break;
+			case '4':
+				break;
+			case '5':
+				break;
+			case '6':
+				break;
+			case '7':
+				break;
+			case '8':
+				break;
+			case '9':
+				break;
+			case '.':
+				if(period_present)
+					return false;
+				else
+					period_present = true;
+				break;
+			case 'e':
+				if(e_present)
+					return false;
+				else
+					e_present = true;
+					ok_negative_loc = i+1;
+					ok_positive_loc = i+1;
+				break;
+			case '-':
+				if( i != ok_negative_loc )
+					return false;
+				else
+					break;
+			case '+':
+				if( i != ok_positive_loc )
+					return false;
+				else
+					break;
+			default:
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+Determines whether the string is a valid long. This is needed because atol will work on invalid
+numbers, e.g. atol(3.23dfs) yields 3. We, however, want it to remain a string should that
+case arise. The only thing we want trimmed is spaces.
+*/
+bool TextFileLoad::_isLong(string str)
+{
+	str = _trim(str);
+
+	for(int i = 0; i<str.length(); i++)
+	{
+		char ch = str[i];
+		switch(ch) {
+			case '0':
+				break;
+			case '1':
+				break;
+			case '2':
+				break;
+			case '3':
+				break;
+			case '4':
+				break;
+			case '5':
+				break;
+			case '6':
+				break;
+			case '7':
+				break;
+			case '8':
+				break;
+			case '9':
+				break;
+			default:
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+Capitalizes a string.
+*/
+string TextFileLoad::_toUpper(string str) const
+{
+
+	for(int i = 0; i<str.length(); i++)
+	{
+		str[i] = toupper(str[i]);
+	}
+	return str;
+}
+
+/*
+Returns the column number for a given column name. If column not found, program exits.
+*/
+int TextFileLoad::_getColNum(string column_name, bool case_sensitive) const
+{
+	if(!case_sensitive)
+		column_name = _toUpper(column_name);
+
+	//Determine the relevant column number
+	for (int col_num = 0; col_num < field_count; col_num++)
+	{
+		string col_name;
+		if(case_sensitive)
+			col_name = field_names[col_num];
+		else
+			col_name = _toUpper(field_names[col_num]);
+
+		if (column_name == col_name)
+		{
+			return col_num;
+		}
+	}
+	printf("\nColumn name %s does not exist!\n", column_name.c_str());
+	exit(1);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// PUBLIC METHODS
+/////////////////////////////////////////////////////////////////////////////
+
+
+/*
+Returns a vector of strings containing the field names for the columns.
+*/
+const vector<string>& TextFileLoad::getFieldNames(void) const
+{
+	return field_names;
+}
+
+/*
+Returns a vector of strings containing the field types for the columns.
+*/
+const vector<string>& TextFileLoad::getFieldTypes(void) const
+{
+	return field_type_names;
+}
+
+/*
+Returns true if the string parameter matches the name of an existing field. Default value for
+case_sensitive parameter is false.
+*/
+bool TextFileLoad::existsFieldName(string name, bool case_sensitive) const
+{
+	if(!case_sensitive)
+		name = _toUpper(name);
+
+	for(int i = 0; i < field_names.size(); i++)
+	{
+		if(case_sensitive && name==field_names[i])
+			return true;
+		else if(name==_toUpper(field_names[i]))
+			return true;
+	}
+	return false;
+}
+
+/*
+Returns the number of columns in the dataset.
+*/
+long TextFileLoad::getFieldCount(void) const
+{
+	return field_count;
+}
+
+/*
+Returns the number of rows in the dataset.
+*/
+long TextFileLoad::getRowCount(void) const
+{
+	return row_count;
+}
+
+/*
+Returns a vector of strings containing the storage type of each column. Unless compact mode
+was requested, this follows directly from the field type.
+*/
+vector<string> TextFileLoad::getStorageTypes(void) const
+{
+	const char* names[] = {"BIT", "INT8", "INT16", "INT32", "INT64", "FLOAT", "DOUBLE", "STRING"};
+	vector<string> types;
+	for(size_t i = 0; i < columns.size(); i++)
+		types.push_back(names[columns[i].st_type]);
+	return types;
+}
+
+/*
+Returns the approximate number of bytes of memory used to store the data, including string
+contents. Data spilled to disk in memory budget mode is not counted.
+*/
+long TextFileLoad::getStorageBytes(void) const
+{
+	unique_lock<recursive_mutex> lock = _lockColumns();
+	long bytes = 0;
+	for(size_t i = 0; i < columns.size(); i++)
+		bytes += _columnBytes(columns[i]);
+	return bytes;
+}
+
+/*
+Returns the text encoding of the file: "UTF-8", "LATIN-1", "UTF-16LE" or "UTF-16BE".
+*/
+string TextFileLoad::getEncoding(void) const
+{
+	const char* names[] = {"UTF-8", "UTF-8", "LATIN-1", "UTF-16LE", "UTF-16BE"};
+	return names[encoding];
+}
+
+/*
+Returns the time spent in each phase of loading the file. All times are 0 for a joined dataset.
+*/
+load_timings TextFileLoad::getLoadTimings(void) const
+{
+	return timings;
+}
+
+/*
+Builds the row-offset index by scanning the file for line breaks, without parsing any fields.
+The offset of every stride-th data row is recorded. Replaces any existing index.
+*/
+void TextFileLoad::buildRowIndex(long stride)
+{
+	const int64_t block_size = 1 << 20;
+	vector<char> block(block_size);
+	int64_t pos = data_start;
+	int64_t line_start = data_start;
+	int64_t rows = 0;
+
+	if(stride <= 0)
+		stride = 1024;
+	row_index.clear();
+	index_stride = stride;
+
+	in_stream.clear();
+	in_stream.seekg(data_start, ios::beg);
+	while(in_stream)
+	{
+		in_stream.read(&block[0], block_size);
+		int64_t len = in_stream.gcount();
+		if(len <= 0)
+			break;
+
+		const char* first = &block[0];
+		const char* last = first + len;
+		const char* newline;
+		while((newline = (const char*)memchr(first, '\n', last - first)) != NULL)
+		{
+			int64_t newline_pos = pos + (newline - &block[0]);
+			if(newline_pos > line_start)
+			{
+				if(rows % stride == 0)
+					row_index.push_back(line_start);
+				rows++;
+			}
+			line_start = newline_pos + 1;
+			first = newline + 1;
+		}
+		pos += len;
+	}
+
+	//The last row may not end with a line break
+	if(pos > line_start)
+	{
+		if(rows % stride == 0)
+			row_index.push_back(line_start);
+		rows++;
+	}
+	index_rows = rows;
+	in_stream.clear();
+}
+
+/*
+Saves the row-offset index next to the text file (default name is the text file name plus
+".idx"), building it first if necessary. Later loads of the same file use it if they name it in
+TextFileLoadOptions::index_file.
+*/
+void TextFileLoad::saveRowIndex(string index_file)
+{
+	if(index_file.length() == 0)
+		index_file = filename + ".idx";
+	if(row_index.empty())
+		buildRowIndex();
+
+	ofstream idx_stream(index_file.c_str(), ios::out | ios::binary);
+	if(!idx_stream)
+	{
+		printf("\n\nERROR: row index file %s failed to open!\n\n", index_file.c_str());
+		exit(1);
+	}
+
+	int64_t header[6];
+	_rowIndexHeader(header);
+	idx_stream.write("TFLIDX2", 8);
+	idx_stream.write((const char*)header, sizeof(header));
+	if(!row_index.empty())
+		idx_stream.write((const char*)&row_index[0], row_index.size() * sizeof(int64_t));
+}
+
+/*
+Returns the byte offset of every getIndexStride()-th data row of the file (empty if no index
+has been built or loaded).
+*/
+vector<int64_t> TextFileLoad::getRowIndex(void) const
+{
+	return row_index;
+}
+
+/*
+Returns the number of rows between entries of the row-offset index (0 if there is no index).
+*/
+long TextFileLoad::getIndexStride(void) const
+{
+	return row_index.empty() ? 0 : index_stride;
+}
+
+/*
+Splits the data rows of the file into chunk_count chunks with about the same number of rows,
+for assigning to parallel workers. Returns up to chunk_count+1 byte offsets (fewer if the file
+has too few indexed rows): chunk i spans offsets i to i+1, and every offset falls on the start
+of a row or the end of the file. Builds the row index if necessary.
+*/
+vector<int64_t> TextFileLoad::getChunkOffsets(int chunk_count)
+{
+	vector<int64_t> offsets;
+	if(row_index.empty())
+		buildRowIndex();
+	if(chunk_count < 1)
+		chunk_count = 1;
+
+	offsets.push_back(data_start);
+	for(int i = 1; i < chunk_count; i++)
+	{
+		size_t entry = (size_t)((double)i * row_index.size() / chunk_count);
+		if(entry > 0 && entry < row_index.size() && row_index[entry] > offsets.back())
+			offsets.push_back(row_index[entry]);
+	}
+	offsets.push_back(file_size);
+	return offsets;
+}
+
+/*
+Returns, for each column, the number of values that did not fit the type declared in the
+user-supplied schema. These values were stored as nulls. All counts are 0 if no schema was given.
+*/
+vector<long> TextFileLoad::getTypeMismatches(void) const
+{
+	return type_mismatches;
+}
+
+/*
+Returns, for each column, the number of times it was promoted to a wider type while loading
+because a value did not fit the type inferred from a sample (see TextFileLoadOptions::infer_rows).
+All counts are 0 with full type inference or a schema. Fixed-width records that are parsed in
+parallel blocks count the promotions of each block.
+*/
+vector<long> TextFileLoad::getTypePromotions(void) const
+{
+	return type_promotions;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// OVERLOADED getField() METHODS
+/////////////////////////////////////////////////////////////////////////////
+/*
+These methods load a column of data from the dataset into a vector. The user is allowed
+to load a vector of booleans, ints, longs, doubles, or strings. Which column is loaded
+can be specified one of two ways:
+	A) User specifies the column name
+	B) User specified the column number (1, 2, etc.)
+These two different ways require different function overloads, so there are two sets of
+overloads.
+
+The getField() methods have been written so that even if a user loads a column of strings
+into a boolean vector, an error will not occur. What does occur is outlined below:
+
+User wants to load the data into a vector:
+
+1) Strings
+	Since all data can be converted successfully into a string, this is not a problem. Doubles
+	are written in the shortest form that converts back to the same value (e.g., 3.23, 3e-09).
+
+2) Doubles
+	If the data is string, a vector of 0's is returned. Otherwise, normal type conversion
+	takes place.
+
+3) Longs
+	If the data is string, a vector of 0's is returned. Otherwise, normal type conversion
+	takes place (e.g., 3.23 becomes 3).
+
+4) Ints
+	If the data is string, a vector of 0's is returned. Otherwise, normal type conversion
+	takes place (e.g., 3.23 becomes 3 and 100000000 is truncated to its integer version).
+
+4) Bools
+	If the data is string, a vector of 0's is returned. Otherwise, normal type conversion
+	takes place.
+*/
+
+/////////////////////////////////////
+// GET BY COLUMN NAME (see (A) above)
+/////////////////////////////////////
+
+/*
+Overloaded version for BOOLS.
+*/
+void TextFileLoad::getField(string field_name, vector <bool>& col_data, bool case_sensitive) const
+{
+	//Determine the relevant column number
+	int col_num = _getColNum(field_name, case_sensitive);
+
+	getField(col_num+1, col_data);
+}
+
+/*
+Overloaded version for INTS.
+*/
+void TextFileLoad::getField(string field_name, vector <int>& col_data, bool case_sensitive) const
+{
+	//Determine the relevant column number
+	int col_num = _getColNum(field_name, case_sensitive);
+
+	getField(col_num+1, col_data);
+}
+
+/*
+Overloaded version for LONGS.
+*/
+void TextFileLoad::getField(string field_name, vector <long>& col_data, bool case_sensitive) const
+{
+	//Determine the relevant column number
+	int col_num = _getColNum(field_name, case_sensitive);
+
+	getField(col_num+1, col_data);
+}
+
+/*
+Overloaded version for DOUBLES.
+*/
+void TextFileLoad::getField(string field_name, vector <double>& col_data, bool case_sensitive) const
+{
+	//Determine the relevant column number
+	int col_num = _getColNum(field_name, case_sensitive);
+
+	getField(col_num+1, col_data);
+}
+
+/*
+Overloaded version for STRINGS.
+*/
+void TextFileLoad::getField(string field_name, vector <string>& col_data, bool case_sensitive) const
+{
+	//Determine the relevant column number
+	int col_num = _getColNum(field_name, case_sensitive);
+
+	getField(col_num+1, col_data);
+}
+
+///////////////////////////////////////
+// GET BY COLUMN NUMBER (see (B) above)
+///////////////////////////////////////
+
+/*
+Overloaded version for BOOLS.
+*/
+void TextFileLoad::getField(int col_num, vector <bool>& col_data) const
+{
+	_getColumn(col_num-1, col_data);
+}
+
+/*
+Overloaded version for INTS.
+*/
+void TextFileLoad::getField(int col_num, vector <int>& col_data) const
+{
+	_getColumn(col_num-1, col_data);
+}
+
+/*
+Overloaded version for LONGS.
+*/
+void TextFileLoad::getField(int col_num, vector <long>& col_data) const
+{
+	_getColumn(col_num-1, col_data);
+}
+
+/*
+Overloaded version for DOUBLES.
+*/
+void TextFileLoad::getField(int col_num, vector <double>& col_data) const
+{
+	_getColumn(col_num-1, col_data);
+}
+
+/*
+Overloaded version for STRINGS.
+*/
+void TextFileLoad::getField(int col_num, vector <string>& col_data) const
+{
+	unique_lock<recursive_mutex> lock = _lockColumns();
+	col_num--;
+	const column& col = _residentColumn(col_num);
+	if(col.st_type == _ST_STRING)
+	{
+		col_data = col.st_string;
+		return;
+	}
+
+	//Dates and timestamps are formatted in ISO 8601 form
+	if(field_types[col_num] == _VT_DATE || field_types[col_num] == _VT_TIMESTAMP)
+	{
+		vector<int64_t> values;
+		_getColumn(col_num, values);
+		char conv[32];
+		col_data.resize(row_count);
+		for(long i = 0; i < row_count; i++)
+		{
+			char* end = (field_types[col_num] == _VT_DATE) ? _formatDate((int32_t)values[i], conv) : _formatTimestamp(values[i], conv);
+			col_data[i].assign(conv, end);
+		}
+		return;
+	}
+
+	//Numbers are formatted according to their field type, whatever width they are stored in:
+	//doubles in shortest round-trip form, everything else as integers.
+	bool as_double = (field_types[col_num] == _VT_DOUBLE);
+	switch(col.st_type)
+	{
+		case _ST_BIT:
+			col_data.resize(row_count);
+			for(long i = 0; i < row_count; i++)
+				col_data[i].assign(1, ((col.st_bit[i / 64] >> (i % 64)) & 1) ? '1' : '0');
+			break;
+		case _ST_INT8:
+			if(as_double)
+				_formatValues<double>(col.st_int8, col_data);
+			else
+				_formatValues<int64_t>(col.st_int8, col_data);
+			break;
+		case _ST_INT16:
+			if(as_double)
+				_formatValues<double>(col.st_int16, col_data);
+			else
+				_formatValues<int64_t>(col.st_int16, col_data);
+			break;
+		case _ST_INT32:
+			if(as_double)
+				_formatValues<double>(col.st_int32, col_data);
+			else
+				_formatValues<int64_t>(col.st_int32, col_data);
+			break;
+		case _ST_INT64:
+			if(as_double)
+				_formatValues<double>(col.st_int64, col_data);
+			else
+				_formatValues<int64_t>(col.st_int64, col_data);
+			break;
+		case _ST_FLOAT:
+			_formatValues<double>(col.st_float, col_data);
+			break;
+		case _ST_DOUBLE:
+			_formatValues<double>(col.st_double, col_data);
+			break;
+		case _ST_STRING:
+			break;
+	}
+}
+
+/*
+Copies a numeric column (0-based) into a vector of type T, converting from whatever width the
+column is stored in. If the data is a string, a vector of 0's is returned.
+*/
+template <typename T>
+void TextFileLoad::_getColumn(int col_num, vector<T>& col_data) const
+{
+	unique_lock<recursive_mutex> lock = _lockColumns();
+	const column& col = _residentColumn(col_num);
+	switch(col.st_type)
+	{
+		case _ST_BIT:
+			_unpackBits(col.st_bit, row_count, col_data);
+			break;
+		case _ST_INT8:
+			_convertValues(col.st_int8, col_data);
+			break;
+		case _ST_INT16:
+			_convertValues(col.st_int16, col_data);
+			break;
+		case _ST_INT32:
+			_convertValues(col.st_int32, col_data);
+			break;
+		case _ST_INT64:
+			_convertValues(col.st_int64, col_data);
+			break;
+		case _ST_FLOAT:
+			_convertValues(col.st_float, col_data);
+			break;
+		case _ST_DOUBLE:
+			_convertValues(col.st_double, col_data);
+			break;
+		case _ST_STRING:
+			col_data.assign(row_count, T());
+	}
+}
+
+/*
+Encodes each value of a column (0-based) as a 64-bit code such that two values are equal exactly
+when their codes are. Integers are their own code, doubles use their bit pattern, and strings
+are numbered in order of first appearance, i.e., dictionary-encoded.
+*/
+void TextFileLoad::_keyCodes(int col_num, vector<int64_t>& codes) const
+{
+	const column& col = _residentColumn(col_num);
+	if(col.st_type == _ST_STRING)
+	{
+		unordered_map<string, int64_t> dictionary;
+		codes.resize(row_count);
+		for(long i = 0; i < row_count; i++)
+			codes[i] = dictionary.insert(make_pair(col.st_string[i], (int64_t)dictionary.size())).first->second;
+	}
+	else if(col.st_type == _ST_FLOAT || col.st_type == _ST_DOUBLE)
+	{
+		vector<double> values;
+		_getColumn(col_num, values);
+		codes.resize(row_count);
+		for(long i = 0; i < row_count; i++)
+		{
+			double value = values[i] + 0.0; //Turns -0.0 into 0.0
+			memcpy(&codes[i], &value, sizeof(value));
+		}
+	}
+	else
+		_getColumn(col_num, codes);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// AGGREGATION
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+Groups found in one hash partition. stats holds the sum, min and max of each value column,
+three entries per value column and group.
+*/
+struct _group_table
+{
+	vector<long> first_row;
+	vector<long> count;
+	vector<double> stats;
+};
+
+/*
+Groups the rows by the key columns and computes the count, sum, mean, min and max of each value
+column within each group. Key columns may have any type; value columns are converted to doubles
+(string columns are treated as 0's, as in getField()). Exits if a column name does not exist.
+
+Each row's key columns are encoded as 64-bit codes and hashed. The groups are then built in an
+open-addressing hash table with linear probing, whose slots hold the hash next to the group
+number so that most probes touch a single cache line. Large inputs are split by the top bits of
+the hash into one partition per thread: the row numbers are scattered once into one list per
+partition (counted first, so the lists are laid out in one array), and each thread builds its
+table from its own list. Partitions share no keys, so the threads build their tables
+independently and the results are simply concatenated.
+*/
+aggregate_result TextFileLoad::aggregate(const vector<string>& key_fields, const vector<string>& value_fields, bool case_sensitive) const
+{
+	unique_lock<recursive_mutex> lock = _lockColumns();
+	aggregate_result result;
+	size_t key_count = key_fields.size();
+	size_t value_count = value_fields.size();
+
+	//Encode the key columns and hash each row
+	vector< vector<int64_t> > codes(key_count);
+	vector<int> key_cols;
+	for(size_t k = 0; k < key_count; k++)
+	{
+		key_cols.push_back(_getColNum(key_fields[k], case_sensitive));
+		result.key_names.push_back(field_names[key_cols[k]]);
+		_keyCodes(key_cols[k], codes[k]);
+	}
+	vector<uint64_t> hashes(row_count);
+	for(long i = 0; i < row_count; i++)
+	{
+		uint64_t h = 0x9e3779b97f4a7c15ULL;
+		for(size_t k = 0; k < key_count; k++)
+			h = _mixHash(h ^ (uint64_t)codes[k][i]);
+		hashes[i] = h;
+	}
+
+	vector< vector<double> > values(value_count);
+	for(size_t v = 0; v < value_count; v++)
+	{
+		int col_num = _getColNum(value_fields[v], case_sensitive);
+		result.value_names.push_back(field_names[col_num]);
+		_getColumn(col_num, values[v]);
+	}
+
+	//Build one hash table per partition
+	unsigned partitions = _workerCount(row_count, 65536);
+	int partition_shift = 64;
+	while((1u << (64 - partition_shift)) < partitions)
+		partition_shift--;
+	vector<_group_table> tables(partitions);
+
+	//Scatter the rows into their partitions, keeping them in row order within each one
+	vector<long> part_rows;
+	vector<long> part_start(partitions + 1, 0);
+	if(partitions == 1)
+		part_start[1] = row_count;
+	else
+	{
+		for(long i = 0; i < row_count; i++)
+			part_start[(hashes[i] >> partition_shift) + 1]++;
+		for(unsigned part = 0; part < partitions; part++)
+			part_start[part + 1] += part_start[part];
+		vector<long> next(part_start.begin(), part_start.end() - 1);
+		part_rows.resize(row_count);
+		for(long i = 0; i < row_count; i++)
+			part_rows[next[hashes[i] >> partition_shift]++] = i;
+	}
+
+	struct slot
+	{
+		uint64_t hash;
+		long group;
+	};
+
+	auto build = [&](unsigned part)
+	{
+		_group_table& table = tables[part];
+		slot empty = {0, -1};
+		vector<slot> slots(1024, empty);
+		size_t mask = slots.size() - 1;
+
+		for(long r = part_start[part]; r < part_start[part + 1]; r++)
+		{
+			long i = (partitions > 1) ? part_rows[r] : r;
+			uint64_t h = hashes[i];
+
+			//Probe for the row's group
+			size_t pos = h & mask;
+			long group = -1;
+			while(slots[pos].group >= 0)
+			{
+				if(slots[pos].hash == h)
+				{
+					long first = table.first_row[slots[pos].group];
+					size_t k = 0;
+					while(k < key_count && codes[k][first] == codes[k][i])
+						k++;
+					if(k == key_count)
+					{
+						group = slots[pos].group;
+						break;
+					}
+				}
+				pos = (pos + 1) & mask;
+			}
+
+			//New group: add it, growing the table when it becomes half full
+			if(group < 0)
+			{
+				group = table.first_row.size();
+				table.first_row.push_back(i);
+				table.count.push_back(0);
+				for(size_t v = 0; v < value_count; v++)
+				{
+					table.stats.push_back(0.0);
+					table.stats.push_back(values[v][i]);
+					table.stats.push_back(values[v][i]);
+				}
+				slots[pos].hash = h;
+				slots[pos].group = group;
+
+				if(table.first_row.size() * 2 > slots.size())
+				{
+					vector<slot> old_slots(slots.size() * 2, empty);
+					old_slots.swap(slots);
+					mask = slots.size() - 1;
+					for(size_t j = 0; j < old_slots.size(); j++)
+					{
+						if(old_slots[j].group < 0)
+							continue;
+						size_t new_pos = old_slots[j].hash & mask;
+						while(slots[new_pos].group >= 0)
+							new_pos = (new_pos + 1) & mask;
+						slots[new_pos] = old_slots[j];
+					}
+				}
+			}
+
+			//Accumulate
+			table.count[group]++;
+			double* stats = value_count ? &table.stats[group * 3 * value_count] : NULL;
+			for(size_t v = 0; v < value_count; v++)
+			{
+				double value = values[v][i];
+				stats[3*v] += value;
+				if(value < stats[3*v+1]) stats[3*v+1] = value;
+				if(value > stats[3*v+2]) stats[3*v+2] = value;
+			}
+		}
+	};
+
+	if(partitions == 1)
+		build(0);
+	else
+	{
+		vector<thread> workers;
+		for(unsigned part = 0; part < partitions; part++)
+			workers.push_back(thread(build, part));
+		for(unsigned part = 0; part < partitions; part++)
+			workers[part].join();
+	}
+
+	//Gather the groups of all partitions, in order of their first row
+	vector< pair<long, pair<unsigned, long> > > order;
+	for(unsigned part = 0; part < partitions; part++)
+	{
+		for(size_t g = 0; g < tables[part].first_row.size(); g++)
+			order.push_back(make_pair(tables[part].first_row[g], make_pair(part, (long)g)));
+	}
+	sort(order.begin(), order.end());
+
+	size_t group_count = order.size();
+	result.sum.assign(value_count, vector<double>(group_count));
+	result.mean.assign(value_count, vector<double>(group_count));
+	result.min.assign(value_count, vector<double>(group_count));
+	result.max.assign(value_count, vector<double>(group_count));
+	for(size_t g = 0; g < group_count; g++)
+	{
+		const _group_table& table = tables[order[g].second.first];
+		long group = order[g].second.second;
+		result.first_row.push_back(order[g].first);
+		result.count.push_back(table.count[group]);
+		for(size_t v = 0; v < value_count; v++)
+		{
+			const double* stats = &table.stats[group * 3 * value_count + 3 * v];
+			result.sum[v][g] = stats[0];
+			result.mean[v][g] = stats[0] / table.count[group];
+			result.min[v][g] = stats[1];
+			result.max[v][g] = stats[2];
+		}
+	}
+
+	//Look up the key values of each group
+	result.keys.resize(key_count);
+	for(size_t k = 0; k < key_count; k++)
+	{
+		vector<string> key_strings;
+		getField(key_cols[k] + 1, key_strings);
+		for(size_t g = 0; g < group_count; g++)
+			result.keys[k].push_back(key_strings[result.first_row[g]]);
+	}
+	return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SORTING
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+Returns the value of one row of a numeric column as a double.
+*/
+static double _numberAt(const column& col, long row)
+{
+	switch(col.st_type)
+	{
+		case _ST_BIT:
+			return (double)((col.st_bit[row / 64] >> (row % 64)) & 1);
+		case _ST_INT8:
+			return col.st_int8[row];
+		case _ST_INT16:
+			return col.st_int16[row];
+		case _ST_INT32:
+			return col.st_int32[row];
+		case _ST_INT64:
+			return (double)col.st_int64[row];
+		case _ST_FLOAT:
+			return col.st_float[row];
+		case _ST_DOUBLE:
+			return col.st_double[row];
+		default:
+			return 0.0;
+	}
+}
+
+/*
+Returns the value of one row of a column stored as bits or integers of any width. Also used by
+TextFileWrite.
+*/
+int64_t TextFileLoad::_integerAt(const column& col, long row)
+{
+	switch(col.st_type)
+	{
+		case _ST_BIT:
+			return (int64_t)((col.st_bit[row / 64] >> (row % 64)) & 1);
+		case _ST_INT8:
+			return col.st_int8[row];
+		case _ST_INT16:
+			return col.st_int16[row];
+		case _ST_INT32:
+			return col.st_int32[row];
+		case _ST_INT64:
+			return col.st_int64[row];
+		default:
+			return 0;
+	}
+}
+
+/*
+Sorts the pointers [first, last) to strings, all of which agree on their first depth characters,
+with multikey quicksort: partition on one character at a time, so common prefixes are compared
+only once.
+*/
+static void _multikeySort(const string** first, const string** last, size_t depth)
+{
+	while(last - first > 1)
+	{
+		//Partition around the middle element's character at this depth (-1 past the end)
+		const string* pivot_str = first[(last - first) / 2];
+		int pivot = (depth < pivot_str->size()) ? (unsigned char)(*pivot_str)[depth] : -1;
+		const string** lt = first;
+		const string** gt = last;
+		const string** i = first;
+		while(i < gt)
+		{
+			int ch = (depth < (*i)->size()) ? (unsigned char)(**i)[depth] : -1;
+			if(ch < pivot)
+				swap(*lt++, *i++);
+			else if(ch > pivot)
+				swap(*i, *--gt);
+			else
+				i++;
+		}
+
+		_multikeySort(first, lt, depth);
+		_multikeySort(gt, last, depth);
+		if(pivot < 0)
+			return;
+		first = lt;
+		last = gt;
+		depth++;
+	}
+}
+
+/*
+Computes for a column (0-based) one unsigned 64-bit key per row whose unsigned order is the
+order of the values. Integers have their sign bit flipped, doubles are mapped to an order-
+preserving bit pattern, and strings are replaced by their rank among the distinct values.
+Descending order inverts the keys.
+*/
+void TextFileLoad::_sortKeys(int col_num, bool ascending, vector<uint64_t>& keys) const
+{
+	const column& col = _residentColumn(col_num);
+	keys.resize(row_count);
+	if(col.st_type == _ST_STRING)
+	{
+		//Rank the distinct values with multikey quicksort
+		vector<int64_t> codes;
+		_keyCodes(col_num, codes);
+		vector<const string*> distinct;
+		for(long i = 0; i < row_count; i++)
+		{
+			if(codes[i] == (int64_t)distinct.size())
+				distinct.push_back(&col.st_string[i]);
+		}
+		vector<const string*> sorted(distinct);
+		if(!sorted.empty())
+			_multikeySort(&sorted[0], &sorted[0] + sorted.size(), 0);
+
+		unordered_map<const string*, uint64_t> rank;
+		for(size_t r = 0; r < sorted.size(); r++)
+			rank[sorted[r]] = r;
+		vector<uint64_t> code_rank(distinct.size());
+		for(size_t c = 0; c < distinct.size(); c++)
+			code_rank[c] = rank[distinct[c]];
+		for(long i = 0; i < row_count; i++)
+			keys[i] = code_rank[codes[i]];
+	}
+	else if(col.st_type == _ST_FLOAT || col.st_type == _ST_DOUBLE)
+	{
+		vector<double> values;
+		_getColumn(col_num, values);
+		for(long i = 0; i < row_count; i++)
+		{
+			double value = values[i] + 0.0; //Turns -0.0 into 0.0
+			uint64_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			keys[i] = (bits >> 63) ? ~bits : (bits | (1ULL << 63));
+		}
+	}
+	else
+	{
+		vector<int64_t> values;
+		_getColumn(col_num, values);
+		for(long i = 0; i < row_count; i++)
+			keys[i] = (uint64_t)values[i] ^ (1ULL << 63);
+	}
+
+	if(!ascending)
+	{
+		for(long i = 0; i < row_count; i++)
+			keys[i] = ~keys[i];
+	}
+}
+
+/*
+Stably sorts rows by key with an LSD radix sort, one byte per pass. Each pass counts the bytes
+of contiguous chunks of the input in parallel, turns the counts into per-chunk output positions,
+and scatters the chunks in parallel. Passes in which every key has the same byte are skipped.
+*/
+static void _radixSort(vector<uint64_t>& keys, vector<long>& rows)
+{
+	size_t n = keys.size();
+	vector<uint64_t> keys_out(n);
+	vector<long> rows_out(n);
+	unsigned workers = _workerCount(n, 65536);
+	vector< vector<size_t> > counts(workers, vector<size_t>(256));
+
+	for(int shift = 0; shift < 64; shift += 8)
+	{
+		//Count the bytes of each chunk
+		auto count = [&](unsigned w)
+		{
+			size_t first = n * w / workers, last = n * (w + 1) / workers;
+			vector<size_t>& c = counts[w];
+			fill(c.begin(), c.end(), 0);
+			for(size_t i = first; i < last; i++)
+				c[(keys[i] >> shift) & 255]++;
+		};
+		vector<thread> threads;
+		for(unsigned w = 1; w < workers; w++)
+			threads.push_back(thread(count, w));
+		count(0);
+		for(size_t t = 0; t < threads.size(); t++)
+			threads[t].join();
+
+		//Skip the pass if all keys share this byte
+		size_t total = 0;
+		for(unsigned w = 0; w < workers; w++)
+			total += counts[w][(keys[0] >> shift) & 255];
+		if(total == n)
+			continue;
+
+		//Output position of each chunk's first key for each byte value
+		size_t pos = 0;
+		for(int b = 0; b < 256; b++)
+		{
+			for(unsigned w = 0; w < workers; w++)
+			{
+				size_t c = counts[w][b];
+				counts[w][b] = pos;
+				pos += c;
+			}
+		}
+
+		auto scatter = [&](unsigned w)
+		{
+			size_t first = n * w / workers, last = n * (w + 1) / workers;
+			vector<size_t>& c = counts[w];
+			for(size_t i = first; i < last; i++)
+			{
+				size_t dest = c[(keys[i] >> shift) & 255]++;
+				keys_out[dest] = keys[i];
+				rows_out[dest] = rows[i];
+			}
+		};
+		threads.clear();
+		for(unsigned w = 1; w < workers; w++)
+			threads.push_back(thread(scatter, w));
+		scatter(0);
+		for(size_t t = 0; t < threads.size(); t++)
+			threads[t].join();
+
+		keys.swap(keys_out);
+		rows.swap(rows_out);
+	}
+}
+
+/*
+Returns the permutation of row numbers (0-based) that sorts the data by the key columns, the
+first key being the most significant. Rows with equal keys keep their original order. Strings
+sort by byte value. Exits if a column name does not exist.
+
+The keys are sorted least significant column first, each with a stable radix sort, so the end
+result is ordered by all key columns together.
+*/
+vector<long> TextFileLoad::getSortedIndex(const vector<string>& key_fields, bool ascending, bool case_sensitive) const
+{
+	unique_lock<recursive_mutex> lock = _lockColumns();
+	vector<long> order(row_count);
+	for(long i = 0; i < row_count; i++)
+		order[i] = i;
+	if(row_count == 0)
+		return order;
+
+	vector<uint64_t> col_keys, keys(row_count);
+	for(size_t k = key_fields.size(); k-- > 0; )
+	{
+		_sortKeys(_getColNum(key_fields[k], case_sensitive), ascending, col_keys);
+		for(long i = 0; i < row_count; i++)
+			keys[i] = col_keys[order[i]];
+		_radixSort(keys, order);
+	}
+	return order;
+}
+
+/*
+Reorders the rows of every column according to order, a permutation as returned by
+getSortedIndex(): row i becomes the previous row order[i]. Exits if order is not a permutation
+of the rows.
+*/
+void TextFileLoad::sortRows(const vector<long>& order)
+{
+	unique_lock<recursive_mutex> lock = _lockColumns();
+	if(order.size() != (size_t)row_count)
+	{
+		printf("\nSort order has %d rows but the data has %ld!\n", (int)order.size(), row_count);
+		exit(1);
+	}
+	vector<bool> seen(row_count, false);
+	for(long i = 0; i < row_count; i++)
+	{
+		if(order[i] < 0 || order[i] >= row_count || seen[order[i]])
+		{
+			printf("\nSort order is not a permutation of the rows: row %ld is out of range or repeated!\n", order[i]);
+			exit(1);
+		}
+		seen[order[i]] = true;
+	}
+
+	for(int col_num = 0; col_num < field_count; col_num++)
+	{
+		column& col = _residentColumn(col_num);
+		switch(col.st_type)
+		{
+			case _ST_BIT:
+			{
+				vector<uint64_t> bits(col.st_bit.size(), 0);
+				for(long i = 0; i < row_count; i++)
+					bits[i / 64] |= ((col.st_bit[order[i] / 64] >> (order[i] % 64)) & 1) << (i % 64);
+				col.st_bit.swap(bits);
+				break;
+			}
+			case _ST_INT8:
+			{
+				vector<int8_t> values(row_count);
+				for(long i = 0; i < row_count; i++)
+					values[i] = col.st_int8[order[i]];
+				col.st_int8.swap(values);
+				break;
+			}
+			case _ST_INT16:
+			{
+				vector<int16_t> values(row_count);
+				for(long i = 0; i < row_count; i++)
+					values[i] = col.st_int16[order[i]];
+				col.st_int16.swap(values);
+				break;
+			}
+			case _ST_INT32:
+			{
+				vector<int32_t> values(row_count);
+				for(long i = 0; i < row_count; i++)
+					values[i] = col.st_int32[order[i]];
+				col.st_int32.swap(values);
+				break;
+			}
+			case _ST_INT64:
+			{
+				vector<int64_t> values(row_count);
+				for(long i = 0; i < row_count; i++)
+					values[i] = col.st_int64[order[i]];
+				col.st_int64.swap(values);
+				break;
+			}
+			case _ST_FLOAT:
+			{
+				vector<float> values(row_count);
+				for(long i = 0; i < row_count; i++)
+					values[i] = col.st_float[order[i]];
+				col.st_float.swap(values);
+				break;
+			}
+			case _ST_DOUBLE:
+			{
+				vector<double> values(row_count);
+				for(long i = 0; i < row_count; i++)
+					values[i] = col.st_double[order[i]];
+				col.st_double.swap(values);
+				break;
+			}
+			case _ST_STRING:
+			{
+				vector<string> values(row_count);
+				for(long i = 0; i < row_count; i++)
+					values[i].swap(col.st_string[order[i]]);
+				col.st_string.swap(values);
+			}
+		}
+	}
+}
+
+/*
+Binary-searches a permutation returned by getSortedIndex() (in ascending order, with field_name
+as its first key) for the rows whose value of field_name equals value. On return, positions
+first to last-1 of order hold those rows; first == last if there are none. For numeric columns
+value is compared as a number, for string columns as a string, and for date and timestamp columns
+as a date or timestamp.
+*/
+void TextFileLoad::findSortedRange(const vector<long>& order, string field_name, string value, long& first, long& last, bool case_sensitive) const
+{
+	unique_lock<recursive_mutex> lock = _lockColumns();
+	int col_num = _getColNum(field_name, case_sensitive);
+	const column& col = _residentColumn(col_num);
+	long n = order.size();
+
+	//below(row, strict) is true if the row's value is less than (strict) or at most the value.
+	//Dates and timestamps compare by their stored day or microsecond count. Columns stored as
+	//integers compare as integers when the value is a whole number, since doubles cannot tell
+	//apart adjacent integers above 2^53.
+	double number = atof(value.c_str());
+	int64_t integer = 0;
+	bool integer_key = true;
+	int32_t days;
+	int64_t micros;
+	const char* value_end = value.data() + value.length();
+	if(field_types[col_num] == _VT_DATE && _parseDate(value.data(), value_end, days))
+		integer = days;
+	else if(field_types[col_num] == _VT_TIMESTAMP && _parseTimestamp(value.data(), value_end, micros))
+		integer = micros;
+	else if(field_types[col_num] == _VT_TIMESTAMP && _parseDate(value.data(), value_end, days))
+		integer = days * 86400000000LL;
+	else if(value.empty() || from_chars(value.data(), value_end, integer).ptr != value_end)
+		integer_key = false;
+	if(integer_key)
+		number = (double)integer;
+	bool integer_storage = (col.st_type == _ST_BIT || col.st_type == _ST_INT8 || col.st_type == _ST_INT16 ||
+		col.st_type == _ST_INT32 || col.st_type == _ST_INT64);
+	auto below = [&](long row, bool strict)
+	{
+		if(col.st_type == _ST_STRING)
+			return strict ? col.st_string[row] < value : col.st_string[row] <= value;
+		if(integer_storage && integer_key)
+		{
+			int64_t row_integer = _integerAt(col, row);
+			return strict ? row_integer < integer : row_integer <= integer;
+		}
+		double row_number = _numberAt(col, row);
+		return strict ? row_number < number : row_number <= number;
+	};
+
+	long lo = 0, hi = n;
+	while(lo < hi)
+	{
+		long mid = lo + (hi - lo) / 2;
+		if(below(order[mid], true)) lo = mid + 1; else hi = mid;
+	}
+	first = lo;
+	hi = n;
+	while(lo < hi)
+	{
+		long mid = lo + (hi - lo) / 2;
+		if(below(order[mid], false)) lo = mid + 1; else hi = mid;
+	}
+	last = lo;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// BOOLEAN COLUMNS
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+Sets the n words of out to op applied to each pair of words of left and right. The words are
+combined in blocks of four through unaliased pointers, which lets the compiler use vector
+instructions at -O2.
+*/
+template <typename Op>
+static void _combineWords(const uint64_t* __restrict left, const uint64_t* __restrict right, uint64_t* __restrict out, size_t n, Op op)
+{
+	size_t blocks = n / 4;
+	for(size_t b = 0; b < blocks; b++)
+	{
+		for(int i = 0; i < 4; i++)
+			out[b * 4 + i] = op(left[b * 4 + i], right[b * 4 + i]);
+	}
+	for(size_t word = blocks * 4; word < n; word++)
+		out[word] = op(left[word], right[word]);
+}
+
+/*
+Returns a copy of the bitmap of a BOOLEAN column: bit i % 64 of word i / 64 is set if row i is
+true. The bits after the last row are 0. Exits if the column is not a BOOLEAN column.
+*/
+vector<uint64_t> TextFileLoad::getBitmap(string field_name, bool case_sensitive) const
+{
+	return getBitmap(_getColNum(field_name, case_sensitive) + 1);
+}
+
+vector<uint64_t> TextFileLoad::getBitmap(int col_num) const
+{
+	if(col_num < 1 || col_num > field_count)
+	{
+		printf("\nColumn %d does not exist!\n", col_num);
+		exit(1);
+	}
+	if(field_types[col_num-1] != _VT_BOOL)
+	{
+		printf("\nColumn %d is not a BOOLEAN column and has no bitmap!\n", col_num);
+		exit(1);
+	}
+
+	unique_lock<recursive_mutex> lock = _lockColumns();
+	const column& col = _residentColumn(col_num-1);
+	if(col.st_type == _ST_BIT)
+		return col.st_bit;
+
+	vector<uint64_t> bits((row_count + 63) / 64, 0);
+	for(long i = 0; i < row_count; i++)
+		bits[i / 64] |= (uint64_t)(_numberAt(col, i) != 0) << (i % 64);
+	return bits;
+}
+
+/*
+Exits unless bits has one word per 64 rows of the data, as the bitmaps of its columns do.
+*/
+void TextFileLoad::_checkBitmap(const vector<uint64_t>& bits) const
+{
+	if(bits.size() != (size_t)((row_count + 63) / 64))
+	{
+		printf("\nBitmap has %d words but the data has %ld rows!\n", (int)bits.size(), row_count);
+		exit(1);
+	}
+}
+
+/*
+Returns the number of rows set in a bitmap.
+*/
+long TextFileLoad::countBits(const vector<uint64_t>& bits) const
+{
+	_checkBitmap(bits);
+	long count = 0;
+	for(size_t word = 0; word < bits.size(); word++)
+		count += __builtin_popcountll(bits[word]);
+	return count;
+}
+
+/*
+Returns the rows set in both bitmaps.
+*/
+vector<uint64_t> TextFileLoad::andBits(const vector<uint64_t>& left, const vector<uint64_t>& right) const
+{
+	_checkBitmap(left);
+	_checkBitmap(right);
+	vector<uint64_t> bits(left.size());
+	_combineWords(left.data(), right.data(), bits.data(), bits.size(), [](uint64_t l, uint64_t r) { return l & r; });
+	return bits;
+}
+
+/*
+Returns the rows set in either bitmap.
+*/
+vector<uint64_t> TextFileLoad::orBits(const vector<uint64_t>& left, const vector<uint64_t>& right) const
+{
+	_checkBitmap(left);
+	_checkBitmap(right);
+	vector<uint64_t> bits(left.size());
+	_combineWords(left.data(), right.data(), bits.data(), bits.size(), [](uint64_t l, uint64_t r) { return l | r; });
+	return bits;
+}
+
+/*
+Returns the rows not set in a bitmap. The bits after the last row stay 0.
+*/
+vector<uint64_t> TextFileLoad::notBits(const vector<uint64_t>& bits) const
+{
+	_checkBitmap(bits);
+	vector<uint64_t> inverted(bits.size());
+	_combineWords(bits.data(), bits.data(), inverted.data(), inverted.size(), [](uint64_t l, uint64_t) { return ~l; });
+	if(row_count % 64 != 0)
+		inverted.back() &= ((uint64_t)1 << (row_count % 64)) - 1;
+	return inverted;
+}
+
+/*
+Returns the rows (0-based) set in a bitmap, in ascending order. Each word is scanned by its set
+bits only, so sparse bitmaps cost little more than their word count.
+*/
+vector<long> TextFileLoad::getSelection(const vector<uint64_t>& bits) const
+{
+	vector<long> rows;
+	rows.reserve(countBits(bits));
+	for(size_t word = 0; word < bits.size(); word++)
+	{
+		for(uint64_t w = bits[word]; w != 0; w &= w - 1)
+			rows.push_back((long)(word * 64 + __builtin_ctzll(w)));
+	}
+	return rows;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// JOINS
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+Fills dst with the values of src at the given rows, in order. Row -1 gives a null (0 or blank).
+*/
+void TextFileLoad::_gatherColumn(const column& src, const vector<long>& rows, column& dst)
+{
+	size_t n = rows.size();
+	dst = column();
+	dst.st_type = src.st_type;
+	switch(src.st_type)
+	{
+		case _ST_BIT:
+			dst.st_bit.assign((n + 63) / 64, 0);
+			for(size_t i = 0; i < n; i++)
+			{
+				if(rows[i] >= 0)
+					dst.st_bit[i / 64] |= ((src.st_bit[rows[i] / 64] >> (rows[i] % 64)) & 1) << (i % 64);
+			}
+			break;
+		case _ST_INT8:
+			dst.st_int8.resize(n);
+			for(size_t i = 0; i < n; i++)
+				dst.st_int8[i] = (rows[i] >= 0) ? src.st_int8[rows[i]] : 0;
+			break;
+		case _ST_INT16:
+			dst.st_int16.resize(n);
+			for(size_t i = 0; i < n; i++)
+				dst.st_int16[i] = (rows[i] >= 0) ? src.st_int16[rows[i]] : 0;
+			break;
+		case _ST_INT32:
+			dst.st_int32.resize(n);
+			for(size_t i = 0; i < n; i++)
+				dst.st_int32[i] = (rows[i] >= 0) ? src.st_int32[rows[i]] : 0;
+			break;
+		case _ST_INT64:
+			dst.st_int64.resize(n);
+			for(size_t i = 0; i < n; i++)
+				dst.st_int64[i] = (rows[i] >= 0) ? src.st_int64[rows[i]] : 0;
+			break;
+		case _ST_FLOAT:
+			dst.st_float.resize(n);
+			for(size_t i = 0; i < n; i++)
+				dst.st_float[i] = (rows[i] >= 0) ? src.st_float[rows[i]] : 0;
+			break;
+		case _ST_DOUBLE:
+			dst.st_double.resize(n);
+			for(size_t i = 0; i < n; i++)
+				dst.st_double[i] = (rows[i] >= 0) ? src.st_double[rows[i]] : 0;
+			break;
+		case _ST_STRING:
+			dst.st_string.resize(n);
+			for(size_t i = 0; i < n; i++)
+			{
+				if(rows[i] >= 0)
+					dst.st_string[i] = src.st_string[rows[i]];
+			}
+	}
+}
+
+/*
+Makes this object the join of two datasets on the key columns left_col and right_col (0-based).
+The result has every left column followed by every right column except the key, in the same
+storage as the inputs, and its rows are ordered by left row and then right row.
+
+The keys of both sides are first encoded as comparable 64-bit codes. Integer keys are their own
+codes and numeric keys use the bit pattern of their double value. If either key is a string
+column, both are compared as strings: the build side is dictionary-encoded, and each probe value
+takes its dictionary code or a code that matches nothing. Both sides are then radix-partitioned
+by the top bits of the hashed code, and each thread builds an open-addressing hash table on the
+smaller side of its partition and probes it with the larger side. The matched row pairs select
+the output rows from the typed columns of the inputs.
+*/
+void TextFileLoad::_join(const TextFileLoad& left, const TextFileLoad& right, int left_col, int right_col, bool keep_unmatched)
+{
+	//Hold both inputs for the whole join. std::lock takes the two locks without deadlocking
+	//against a concurrent join of the same datasets in the other order.
+	unique_lock<recursive_mutex> left_lock(left.column_mutex, defer_lock);
+	unique_lock<recursive_mutex> right_lock(right.column_mutex, defer_lock);
+	if(&left == &right)
+		left_lock.lock();
+	else
+		lock(left_lock, right_lock);
+
+	//The joined data does not come from a file
+	delimiter = left.delimiter;
+	header_row = true;
+	offset = 0;
+	use_schema = false;
+	data_start = 0;
+	file_size = 0;
+	index_stride = 0;
+	index_rows = 0;
+	memory_budget = 0;
+	data_visited = false;
+	record_length = 0;
+	use_clock = 0;
+	encoding = _ENC_UTF8;
+	check_utf8 = false;
+	latin1_text = false;
+	utf8_rows = false;
+	text_start = 0;
+
+	//The smaller side is the build side
+	bool left_builds = (left.row_count <= right.row_count);
+	const TextFileLoad& build = left_builds ? left : right;
+	const TextFileLoad& probe = left_builds ? right : left;
+	int build_col = left_builds ? left_col : right_col;
+	int probe_col = left_builds ? right_col : left_col;
+
+	//Encode the keys of both sides as comparable codes
+	vector<int64_t> build_codes, probe_codes;
+	_ST_TYPE build_type = build._residentColumn(build_col).st_type;
+	_ST_TYPE probe_type = probe._residentColumn(probe_col).st_type;
+	bool build_real = (build_type == _ST_FLOAT || build_type == _ST_DOUBLE);
+	bool probe_real = (probe_type == _ST_FLOAT || probe_type == _ST_DOUBLE);
+	if(build_type == _ST_STRING || probe_type == _ST_STRING)
+	{
+		vector<string> build_keys, probe_keys;
+		build.getField(build_col + 1, build_keys);
+		probe.getField(probe_col + 1, probe_keys);
+		unordered_map<string, int64_t> dictionary;
+		build_codes.resize(build_keys.size());
+		for(size_t i = 0; i < build_keys.size(); i++)
+			build_codes[i] = dictionary.insert(make_pair(build_keys[i], (int64_t)dictionary.size())).first->second;
+		probe_codes.resize(probe_keys.size());
+		for(size_t i = 0; i < probe_keys.size(); i++)
+		{
+			unordered_map<string, int64_t>::const_iterator it = dictionary.find(probe_keys[i]);
+			probe_codes[i] = (it == dictionary.end()) ? -1 : it->second;
+		}
+	}
+	else if(build_real || probe_real)
+	{
+		const TextFileLoad* sides[2] = {&build, &probe};
+		int cols[2] = {build_col, probe_col};
+		vector<int64_t>* codes[2] = {&build_codes, &probe_codes};
+		for(int side = 0; side < 2; side++)
+		{
+			vector<double> values;
+			sides[side]->_getColumn(cols[side], values);
+			codes[side]->resize(values.size());
+			for(size_t i = 0; i < values.size(); i++)
+			{
+				double value = values[i] + 0.0; //Turns -0.0 into 0.0
+				memcpy(&(*codes[side])[i], &value, sizeof(value));
+			}
+		}
+	}
+	else
+	{
+		build._getColumn(build_col, build_codes);
+		probe._getColumn(probe_col, probe_codes);
+	}
+
+	//Radix-partition the row numbers of both sides by the top bits of their hashed codes
+	unsigned partitions = _workerCount(build_codes.size() + probe_codes.size(), 65536);
+	int partition_shift = 64;
+	while((1u << (64 - partition_shift)) < partitions)
+		partition_shift--;
+	vector< vector<long> > build_parts(partitions), probe_parts(partitions);
+	for(size_t i = 0; i < build_codes.size(); i++)
+		build_parts[partitions > 1 ? _mixHash(build_codes[i]) >> partition_shift : 0].push_back(i);
+	for(size_t i = 0; i < probe_codes.size(); i++)
+		probe_parts[partitions > 1 ? _mixHash(probe_codes[i]) >> partition_shift : 0].push_back(i);
+
+	//Build and probe each partition. A string probe value missing from the dictionary matches nothing.
+	bool string_keys = (build_type == _ST_STRING || probe_type == _ST_STRING);
+	vector< vector< pair<long, long> > > matches(partitions); //(left row, right row)
+	vector<char> build_matched(build_codes.size(), 0);
+	auto join_partition = [&](unsigned part)
+	{
+		const vector<long>& build_rows = build_parts[part];
+		size_t capacity = 16;
+		while(capacity < build_rows.size() * 2)
+			capacity *= 2;
+		size_t mask = capacity - 1;
+
+		//Each slot holds a key and its first build row; further rows with that key are chained in next
+		vector<int64_t> slot_key(capacity);
+		vector<long> slot_row(capacity, -1);
+		vector<long> next(build_rows.size(), -1);
+		for(size_t j = 0; j < build_rows.size(); j++)
+		{
+			int64_t key = build_codes[build_rows[j]];
+			size_t pos = _mixHash(key) & mask;
+			while(slot_row[pos] >= 0 && slot_key[pos] != key)
+				pos = (pos + 1) & mask;
+			if(slot_row[pos] < 0)
+				slot_key[pos] = key;
+			else
+				next[j] = slot_row[pos];
+			slot_row[pos] = j;
+		}
+
+		vector< pair<long, long> >& out = matches[part];
+		const vector<long>& probe_rows = probe_parts[part];
+		for(size_t j = 0; j < probe_rows.size(); j++)
+		{
+			long probe_row = probe_rows[j];
+			int64_t key = probe_codes[probe_row];
+			long found = -1;
+			if(!string_keys || key >= 0)
+			{
+				size_t pos = _mixHash(key) & mask;
+				while(slot_row[pos] >= 0 && slot_key[pos] != key)
+					pos = (pos + 1) & mask;
+				found = slot_row[pos];
+			}
+
+			if(found < 0 && keep_unmatched && !left_builds)
+				out.push_back(make_pair(probe_row, -1L));
+			for(long b = found; b >= 0; b = next[b])
+			{
+				long build_row = build_rows[b];
+				build_matched[build_row] = 1;
+				if(left_builds)
+					out.push_back(make_pair(build_row, probe_row));
+				else
+					out.push_back(make_pair(probe_row, build_row));
+			}
+		}
+	};
+
+	if(partitions == 1)
+		join_partition(0);
+	else
+	{
+		vector<thread> workers;
+		for(unsigned part = 0; part < partitions; part++)
+			workers.push_back(thread(join_partition, part));
+		for(unsigned part = 0; part < partitions; part++)
+			workers[part].join();
+	}
+
+	//Collect the matches, plus unmatched left rows of a left join whose left side was the build side
+	vector< pair<long, long> > pairs;
+	for(unsigned part = 0; part < partitions; part++)
+	{
+		pairs.insert(pairs.end(), matches[part].begin(), matches[part].end());
+		vector< pair<long, long> >().swap(matches[part]);
+	}
+	if(keep_unmatched && left_builds)
+	{
+		for(size_t i = 0; i < build_matched.size(); i++)
+		{
+			if(!build_matched[i])
+				pairs.push_back(make_pair((long)i, -1L));
+		}
+	}
+	sort(pairs.begin(), pairs.end());
+
+	//Gather the output columns
+	vector<long> left_rows(pairs.size()), right_rows(pairs.size());
+	for(size_t i = 0; i < pairs.size(); i++)
+	{
+		left_rows[i] = pairs[i].first;
+		right_rows[i] = pairs[i].second;
+	}
+	row_count = pairs.size();
+	for(int col_num = 0; col_num < left.field_count; col_num++)
+	{
+		columns.push_back(column());
+		_gatherColumn(left._residentColumn(col_num), left_rows, columns.back());
+		field_types.push_back(left.field_types[col_num]);
+		field_names.push_back((size_t)col_num < left.field_names.size() ? left.field_names[col_num] : "");
+	}
+	for(int col_num = 0; col_num < right.field_count; col_num++)
+	{
+		if(col_num == right_col)
+			continue;
+		columns.push_back(column());
+		_gatherColumn(right._residentColumn(col_num), right_rows, columns.back());
+		field_types.push_back(right.field_types[col_num]);
+		field_names.push_back((size_t)col_num < right.field_names.size() ? right.field_names[col_num] : "");
+	}
+	field_count = columns.size();
+	type_mismatches.assign(field_count, 0);
+	type_promotions.assign(field_count, 0);
+	sampled_types = false;
+	_setFieldTypeNames();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// MEMORY BUDGET
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+Locks the column data for the calling thread and returns the lock, which is released when it goes
+out of scope. Only memory budget mode needs it: there, reading a column can spill other columns and
+read this one back, so concurrent readers take turns. Without a budget the data never changes after
+loading and readers do not lock at all. The mutex is recursive because the public methods that
+lock call each other.
+*/
+unique_lock<recursive_mutex> TextFileLoad::_lockColumns(void) const
+{
+	if(memory_budget <= 0)
+		return unique_lock<recursive_mutex>();
+	return unique_lock<recursive_mutex>(column_mutex);
+}
+
+/*
+Returns the approximate number of bytes of memory held by a column.
+*/
+int64_t TextFileLoad::_columnBytes(const column& col) const
+{
+	int64_t bytes = 0;
+	bytes += col.st_bit.capacity() * sizeof(uint64_t);
+	bytes += col.st_int8.capacity() * sizeof(int8_t);
+	bytes += col.st_int16.capacity() * sizeof(int16_t);
+	bytes += col.st_int32.capacity() * sizeof(int32_t);
+	bytes += col.st_int64.capacity() * sizeof(int64_t);
+	bytes += col.st_float.capacity() * sizeof(float);
+	bytes += col.st_double.capacity() * sizeof(double);
+	bytes += col.st_string.capacity() * sizeof(string);
+	for(size_t j = 0; j < col.st_string.size(); j++)
+		bytes += col.st_string[j].capacity();
+	return bytes;
+}
+
+/*
+Appends raw values to a spill file.
+*/
+template <typename T>
+static void _writeValues(ofstream& out, vector<T>& values)
+{
+	if(!values.empty())
+		out.write((const char*)&values[0], values.size() * sizeof(T));
+	vector<T>().swap(values);
+}
+
+/*
+Replaces values with n raw values read from a spill file followed by the old contents. The file
+is read straight into the new vector, with no intermediate copy.
+*/
+template <typename T>
+static void _readValues(ifstream& in, long n, vector<T>& values)
+{
+	vector<T> all(n + values.size());
+	if(n > 0)
+		in.read((char*)&all[0], n * sizeof(T));
+	copy(values.begin(), values.end(), all.begin() + n);
+	values.swap(all);
+}
+
+/*
+Moves the values of a column that are in memory to the end of its spill file, creating the file
+if necessary, and releases their memory. Bits are written one per byte and strings as a 32-bit
+length followed by their characters.
+*/
+void TextFileLoad::_spillColumn(int col_num) const
+{
+	column& col = columns[col_num];
+	long resident_rows = row_count - col.spill_rows;
+	if(resident_rows <= 0)
+		return;
+
+	if(col.spill_file.empty())
+	{
+		string path = spill_directory + "/tflspill_XXXXXX";
+		vector<char> path_buf(path.begin(), path.end());
+		path_buf.push_back('\0');
+		int fd = mkstemp(&path_buf[0]);
+		if(fd < 0)
+		{
+			printf("\n\nERROR: spill file in %s failed to open!\n\n", spill_directory.c_str());
+			exit(1);
+		}
+		close(fd);
+		col.spill_file = &path_buf[0];
+	}
+
+	ofstream out(col.spill_file.c_str(), ios::out | ios::binary | ios::app);
+	switch(col.st_type)
+	{
+		case _ST_BIT:
+		{
+			vector<char> bytes(resident_rows);
+			for(long i = 0; i < resident_rows; i++)
+				bytes[i] = (char)((col.st_bit[i / 64] >> (i % 64)) & 1);
+			_writeValues(out, bytes);
+			vector<uint64_t>().swap(col.st_bit);
+			break;
+		}
+		case _ST_INT8:
+			_writeValues(out, col.st_int8);
+			break;
+		case _ST_INT16:
+			_writeValues(out, col.st_int16);
+			break;
+		case _ST_INT32:
+			_writeValues(out, col.st_int32);
+			break;
+		case _ST_INT64:
+			_writeValues(out, col.st_int64);
+			break;
+		case _ST_FLOAT:
+			_writeValues(out, col.st_float);
+			break;
+		case _ST_DOUBLE:
+			_writeValues(out, col.st_double);
+			break;
+		case _ST_STRING:
+			for(long i = 0; i < resident_rows; i++)
+			{
+				uint32_t len = col.st_string[i].length();
+				out.write((const char*)&len, sizeof(len));
+				out.write(col.st_string[i].data(), len);
+			}
+			vector<string>().swap(col.st_string);
+	}
+	if(!out)
+	{
+		printf("\n\nERROR: failed to write spill file %s!\n\n", col.spill_file.c_str());
+		exit(1);
+	}
+
+	col.spill_rows = row_count;
+	if(!column_bytes.empty())
+		column_bytes[col_num] = 0;
+}
+
+/*
+Spills the least recently used columns (other than keep_col) until bytes more bytes fit within
+the memory budget.
+*/
+void TextFileLoad::_makeRoom(int64_t bytes, int keep_col) const
+{
+	while(true)
+	{
+		int64_t used = 0;
+		int victim = -1;
+		for(int col_num = 0; col_num < field_count; col_num++)
+		{
+			used += column_bytes[col_num];
+			if(col_num != keep_col && column_bytes[col_num] > 0 &&
+				(victim < 0 || column_last_used[col_num] < column_last_used[victim]))
+				victim = col_num;
+		}
+		if(used + bytes <= memory_budget || victim < 0)
+			return;
+		_spillColumn(victim);
+	}
+}
+
+/*
+Returns a column (0-based) with all of its values in memory. Exits if the column has been taken.
+In memory budget mode, spilled values are streamed back from the spill file, after least recently
+used columns have been spilled to make room for them, and the spill file is removed. Only the
+column itself (and the stream's buffer) takes memory: the file is not mapped or read whole.
+*/
+column& TextFileLoad::_residentColumn(int col_num) const
+{
+	column& col = columns[col_num];
+	if(data_visited)
+	{
+		printf("\nThe data was passed to a visitor and not stored, so column %d cannot be loaded!\n", col_num+1);
+		exit(1);
+	}
+	if(field_taken[col_num])
+	{
+		printf("\nColumn %d has been taken by takeField() and can no longer be loaded!\n", col_num+1);
+		exit(1);
+	}
+	if(memory_budget <= 0)
+		return col;
+
+	column_last_used[col_num] = ++use_clock;
+	if(col.spill_file.empty())
+		return col;
+
+	ifstream in(col.spill_file.c_str(), ios::in | ios::binary | ios::ate);
+	if(!in)
+	{
+		printf("\n\nERROR: spill file %s failed to open!\n\n", col.spill_file.c_str());
+		exit(1);
+	}
+	size_t size = in.tellg();
+	in.seekg(0, ios::beg);
+	_makeRoom(size + (col.st_type == _ST_STRING ? col.spill_rows * sizeof(string) : 0), col_num);
+
+	long n = col.spill_rows;
+	switch(col.st_type)
+	{
+		case _ST_BIT:
+		{
+			//Bits were spilled one per byte; they are packed again a block at a time
+			vector<uint64_t> bits((row_count + 63) / 64, 0);
+			vector<char> block(65536);
+			for(long first = 0; first < n; first += block.size())
+			{
+				long count = min((long)block.size(), n - first);
+				in.read(&block[0], count);
+				for(long i = 0; i < count; i++)
+					bits[(first + i) / 64] |= (uint64_t)(block[i] != 0) << ((first + i) % 64);
+			}
+			for(long i = n; i < row_count; i++)
+				bits[i / 64] |= ((col.st_bit[(i - n) / 64] >> ((i - n) % 64)) & 1) << (i % 64);
+			col.st_bit.swap(bits);
+			break;
+		}
+		case _ST_INT8:
+			_readValues(in, n, col.st_int8);
+			break;
+		case _ST_INT16:
+			_readValues(in, n, col.st_int16);
+			break;
+		case _ST_INT32:
+			_readValues(in, n, col.st_int32);
+			break;
+		case _ST_INT64:
+			_readValues(in, n, col.st_int64);
+			break;
+		case _ST_FLOAT:
+			_readValues(in, n, col.st_float);
+			break;
+		case _ST_DOUBLE:
+			_readValues(in, n, col.st_double);
+			break;
+		case _ST_STRING:
+		{
+			vector<string> all(row_count);
+			for(long i = 0; i < n; i++)
+			{
+				uint32_t len = 0;
+				in.read((char*)&len, sizeof(len));
+				all[i].resize(len);
+				if(len > 0)
+					in.read(&all[i][0], len);
+			}
+			for(long i = n; i < row_count; i++)
+				all[i].swap(col.st_string[i - n]);
+			col.st_string.swap(all);
+		}
+	}
+	if(!in)
+	{
+		printf("\n\nERROR: failed to read spill file %s!\n\n", col.spill_file.c_str());
+		exit(1);
+	}
+
+	in.close();
+	unlink(col.spill_file.c_str());
+	col.spill_file.clear();
+	col.spill_rows = 0;
+	column_bytes[col_num] = _columnBytes(col);
+	return col;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// OVERLOADED takeField() METHODS
+/////////////////////////////////////////////////////////////////////////////
+/*
+These methods work like the getField() methods, with the same type conversions, except that the
+column is moved out of the object rather than copied, and its memory is released right away.
+*/
+
+/*
+Swaps the storage of a column into col_data if its storage type is exactly T. Returns false,
+leaving both unchanged, otherwise.
+*/
+template <typename T, typename S>
+static bool _swapStorage(vector<S>& storage, vector<T>& col_data)
+{
+	if constexpr (is_same<T, S>::value)
+	{
+		col_data.swap(storage);
+		vector<S>().swap(storage);
+		return true;
+	}
+	return false;
+}
+
+/*
+Moves a column (0-based) into col_data, converting it only if its storage type differs from T,
+and then releases the column.
+*/
+template <typename T>
+void TextFileLoad::_takeColumn(int col_num, vector<T>& col_data)
+{
+	unique_lock<recursive_mutex> lock = _lockColumns();
+	column& col = _residentColumn(col_num);
+	bool moved = false;
+	switch(col.st_type)
+	{
+		case _ST_INT32:
+			moved = _swapStorage(col.st_int32, col_data);
+			break;
+		case _ST_INT64:
+			moved = _swapStorage(col.st_int64, col_data);
+			break;
+		case _ST_DOUBLE:
+			moved = _swapStorage(col.st_double, col_data);
+			break;
+		case _ST_STRING:
+			moved = _swapStorage(col.st_string, col_data);
+			break;
+		default:
+			break;
+	}
+	if(!moved)
+	{
+		if constexpr (is_same<T, string>::value)
+			getField(col_num + 1, col_data);
+		else
+			_getColumn(col_num, col_data);
+	}
+
+	_ST_TYPE st_type = col.st_type;
+	col = column();
+	col.st_type = st_type;
+	field_taken[col_num] = true;
+	if(!column_bytes.empty())
+		column_bytes[col_num] = 0;
+}
+
+/*
+Overloaded version for BOOLS, by column name.
+*/
+void TextFileLoad::takeField(string field_name, vector <bool>& col_data, bool case_sensitive)
+{
+	_takeColumn(_getColNum(field_name, case_sensitive), col_data);
+}
+
+/*
+Overloaded version for INTS, by column name.
+*/
+void TextFileLoad::takeField(string field_name, vector <int>& col_data, bool case_sensitive)
+{
+	_takeColumn(_getColNum(field_name, case_sensitive), col_data);
+}
+
+/*
+Overloaded version for LONGS, by column name.
+*/
+void TextFileLoad::takeField(string field_name, vector <long>& col_data, bool case_sensitive)
+{
+	_takeColumn(_getColNum(field_name, case_sensitive), col_data);
+}
+
+/*
+Overloaded version for DOUBLES, by column name.
+*/
+void TextFileLoad::takeField(string field_name, vector <double>& col_data, bool case_sensitive)
+{
+	_takeColumn(_getColNum(field_name, case_sensitive), col_data);
+}
+
+/*
+Overloaded version for STRINGS, by column name.
+*/
+void TextFileLoad::takeField(string field_name, vector <string>& col_data, bool case_sensitive)
+{
+	_takeColumn(_getColNum(field_name, case_sensitive), col_data);
+}
+
+/*
+Overloaded version for BOOLS, by column number.
+*/
+void TextFileLoad::takeField(int col_num, vector <bool>& col_data)
+{
+	_takeColumn(col_num-1, col_data);
+}
+
+/*
+Overloaded version for INTS, by column number.
+*/
+void TextFileLoad::takeField(int col_num, vector <int>& col_data)
+{
+	_takeColumn(col_num-1, col_data);
+}
+
+/*
+Overloaded version for LONGS, by column number.
+*/
+void TextFileLoad::takeField(int col_num, vector <long>& col_data)
+{
+	_takeColumn(col_num-1, col_data);
 }
 
 /*
-Returns the number of columns in the dataset.
+Overloaded version for DOUBLES, by column number.
 */
-long TextFileLoad::getFieldCount(void)
+void TextFileLoad::takeField(int col_num, vector <double>& col_data)
 {
-	return field_count;
+	_takeColumn(col_num-1, col_data);
 }
 
 /*
-Returns the number of rows in the dataset.
+Overloaded version for STRINGS, by column number.
 */
-long TextFileLoad::getRowCount(void)
+void TextFileLoad::takeField(int col_num, vector <string>& col_data)
 {
-	return row_count;
+	_takeColumn(col_num-1, col_data);
 }
 
 /////////////////////////////////////////////////////////////////////////////
-// OVERLOADED getField() METHODS
+// DATES AND TIMESTAMPS
 /////////////////////////////////////////////////////////////////////////////
 /*
-These methods load a column of data from the dataset into a vector. The user is allowed
-to load a vector of booleans, ints, longs, doubles, or strings. Which column is loaded
-can be specified one of two ways:
-	A) User specifies the column name
-	B) User specified the column number (1, 2, etc.)
-These two different ways require different function overloads, so there are two sets of
-overloads.
-
-The getField() methods have been written so that even if a user loads a column of strings
-into a boolean vector, an error will not occur. What does occur is outlined below:
-
-User wants to load the data into a vector:
-
-1) Strings
-	Since all data can be converted successfully into a string, this is not a problem.
-
-2) Doubles
-	If the data is string, a vector of 0's is returned. Otherwise, normal type conversion
-	takes place.
-
-3) Longs
-	If the data is string, a vector of 0's is returned. Otherwise, normal type conversion
-	takes place (e.g., 3.23 becomes 3).
-
-4) Ints
-	If the data is string, a vector of 0's is returned. Otherwise, normal type conversion
-	takes place (e.g., 3.23 becomes 3 and 100000000 is truncated to its integer version).
-
-4) Bools
-	If the data is string, a vector of 0's is returned. Otherwise, normal type conversion
-	takes place.
+Dates are stored as int32 days since 1970-01-01 and timestamps as int64 microseconds since
+1970-01-01 00:00:00 UTC. Both are parsed from fixed-format text: the layout is validated in one
+branch-free pass over the characters and the digits are then read from fixed positions, so no
+general-purpose parser (strptime, sscanf) is involved.
 */
 
-/////////////////////////////////////
-// GET BY COLUMN NAME (see (A) above)
-/////////////////////////////////////
-
 /*
-Overloaded version for BOOLS.
+Returns true if the n characters at str match pattern, where 'd' stands for any digit and every
+other pattern character must match exactly. The loop has no early exit or data-dependent branch,
+so the compiler can vectorize it.
 */
-void TextFileLoad::getField(string field_name, vector <bool>& col_data, bool case_sensitive)
+static inline bool _matchPattern(const char* str, const char* pattern, int n)
 {
-	//Determine the relevant column number
-	int col_num = _getColNum(field_name, case_sensitive);
-
-	getField(col_num+1, col_data);
+	unsigned bad = 0;
+	for(int i = 0; i < n; i++)
+	{
+		unsigned char ch = str[i];
+		unsigned char pat = pattern[i];
+		bad |= (pat == 'd') ? (unsigned)((unsigned char)(ch - '0') > 9) : (unsigned)(ch != pat);
+	}
+	return bad == 0;
 }
 
 /*
-Overloaded version for INTS.
+Returns the value of n digits at str, which must already have been validated.
 */
-void TextFileLoad::getField(string field_name, vector <int>& col_data, bool case_sensitive)
+static inline int _digitValue(const char* str, int n)
 {
-	//Determine the relevant column number
-	int col_num = _getColNum(field_name, case_sensitive);
-
-	getField(col_num+1, col_data);
+	int value = 0;
+	for(int i = 0; i < n; i++)
+		value = value * 10 + (str[i] - '0');
+	return value;
 }
 
 /*
-Overloaded version for LONGS.
+Returns the number of days from 1970-01-01 to a date of the proleptic Gregorian calendar
+(H. Hinnant's days_from_civil).
 */
-void TextFileLoad::getField(string field_name, vector <long>& col_data, bool case_sensitive)
+static int32_t _daysFromCivil(int y, int m, int d)
 {
-	//Determine the relevant column number
-	int col_num = _getColNum(field_name, case_sensitive);
+	y -= (m <= 2);
+	int era = (y >= 0 ? y : y - 399) / 400;
+	int yoe = y - era * 400;
+	int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
 
-	getField(col_num+1, col_data);
+/*
+Inverse of _daysFromCivil().
+*/
+static void _civilFromDays(int32_t days, int& y, int& m, int& d)
+{
+	days += 719468;
+	int era = (days >= 0 ? days : days - 146096) / 146097;
+	int doe = days - era * 146097;
+	int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	int mp = (5 * doy + 2) / 153;
+	d = doy - (153 * mp + 2) / 5 + 1;
+	m = mp + (mp < 10 ? 3 : -9);
+	y = yoe + era * 400 + (m <= 2);
 }
 
 /*
-Overloaded version for DOUBLES.
+Returns true if y-m-d is a valid calendar date.
 */
-void TextFileLoad::getField(string field_name, vector <double>& col_data, bool case_sensitive)
+static bool _validDate(int y, int m, int d)
 {
-	//Determine the relevant column number
-	int col_num = _getColNum(field_name, case_sensitive);
+	static const int month_days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	if(m < 1 || m > 12 || d < 1)
+		return false;
+	bool leap = (y % 4 == 0 && (y % 100 != 0 || y % 400 == 0));
+	return d <= month_days[m - 1] + (m == 2 && leap);
+}
 
-	getField(col_num+1, col_data);
+/*
+Writes n digits of value at out, with leading zeros.
+*/
+static inline void _putDigits(char* out, int value, int n)
+{
+	for(int i = n - 1; i >= 0; i--)
+	{
+		out[i] = (char)('0' + value % 10);
+		value /= 10;
+	}
 }
 
 /*
-Overloaded version for STRINGS.
+Parses a date of the form YYYY-MM-DD, surrounded by optional spaces, into days since 1970-01-01.
+Returns false (leaving days unchanged) if the text is not such a date.
 */
-void TextFileLoad::getField(string field_name, vector <string>& col_data, bool case_sensitive)
+bool TextFileLoad::_parseDate(const char* first, const char* last, int32_t& days)
 {
-	//Determine the relevant column number
-	int col_num = _getColNum(field_name, case_sensitive);
+	while(first < last && *first == ' ')
+		first++;
+	while(last > first && last[-1] == ' ')
+		last--;
+	if(last - first != 10 || !_matchPattern(first, "dddd-dd-dd", 10))
+		return false;
 
-	getField(col_num+1, col_data);
+	int y = _digitValue(first, 4), m = _digitValue(first + 5, 2), d = _digitValue(first + 8, 2);
+	if(!_validDate(y, m, d))
+		return false;
+	days = _daysFromCivil(y, m, d);
+	return true;
 }
 
-///////////////////////////////////////
-// GET BY COLUMN NUMBER (see (B) above)
-///////////////////////////////////////
-
 /*
-Overloaded version for BOOLS.
+Parses a timestamp of the form YYYY-MM-DDTHH:MM:SS (or with a space instead of the T), with an
+optional fraction of a second of up to 9 digits (truncated to microseconds) and an optional time
+zone (Z, +HH:MM, -HH:MM, +HHMM or -HHMM), surrounded by optional spaces, into microseconds since
+1970-01-01 00:00:00 UTC. Timestamps without a time zone are taken as UTC. Returns false (leaving
+micros unchanged) if the text is not such a timestamp.
 */
-void TextFileLoad::getField(int col_num, vector <bool>& col_data)
+bool TextFileLoad::_parseTimestamp(const char* first, const char* last, int64_t& micros)
 {
-	col_num--;
-	col_data.clear();
+	while(first < last && *first == ' ')
+		first++;
+	while(last > first && last[-1] == ' ')
+		last--;
+	if(last - first < 19 || !_matchPattern(first, "dddd-dd-dd", 10) ||
+		(first[10] != 'T' && first[10] != ' ') || !_matchPattern(first + 11, "dd:dd:dd", 8))
+		return false;
 
-	//Load the data into the vector, and do any necessary type conversions
-	switch(field_types[col_num])
-	{
-		case _VT_BOOL:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(data[i][col_num].vt_bool);
-			}
-			break;
+	int y = _digitValue(first, 4), m = _digitValue(first + 5, 2), d = _digitValue(first + 8, 2);
+	int hh = _digitValue(first + 11, 2), mm = _digitValue(first + 14, 2), ss = _digitValue(first + 17, 2);
+	if(!_validDate(y, m, d) || hh > 23 || mm > 59 || ss > 59)
+		return false;
 
-		case _VT_INT:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back((bool)data[i][col_num].vt_int);
-			}
-			break;
+	//Fraction of a second
+	const char* pos = first + 19;
+	int64_t fraction = 0;
+	if(pos < last && *pos == '.')
+	{
+		pos++;
+		int digits = 0;
+		while(pos < last && *pos >= '0' && *pos <= '9' && digits < 9)
+		{
+			if(digits < 6)
+				fraction = fraction * 10 + (*pos - '0');
+			pos++;
+			digits++;
+		}
+		if(digits == 0)
+			return false;
+		for(; digits < 6; digits++)
+			fraction *= 10;
+	}
 
-		case _VT_LONG:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back((bool)data[i][col_num].vt_long);
-			}
-			break;
+	//Time zone
+	int64_t zone_seconds = 0;
+	if(pos < last && *pos == 'Z')
+		pos++;
+	else if(pos < last && (*pos == '+' || *pos == '-'))
+	{
+		int sign = (*pos == '-') ? -1 : 1;
+		pos++;
+		int zh, zm;
+		if(last - pos == 5 && _matchPattern(pos, "dd:dd", 5))
+			zh = _digitValue(pos, 2), zm = _digitValue(pos + 3, 2);
+		else if(last - pos == 4 && _matchPattern(pos, "dddd", 4))
+			zh = _digitValue(pos, 2), zm = _digitValue(pos + 2, 2);
+		else
+			return false;
+		if(zh > 23 || zm > 59)
+			return false;
+		zone_seconds = sign * (zh * 3600 + zm * 60);
+		pos = last;
+	}
+	if(pos != last)
+		return false;
 
-		case _VT_DOUBLE:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back((bool)data[i][col_num].vt_double);
-			}
-			break;
+	int64_t seconds = (int64_t)_daysFromCivil(y, m, d) * 86400 + hh * 3600 + mm * 60 + ss - zone_seconds;
+	micros = seconds * 1000000 + fraction;
+	return true;
+}
 
-		case _VT_STRING:
-			//If the data is a string, just push back 0's.
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(0);
-			}
+/*
+Writes a date (days since 1970-01-01) at out as YYYY-MM-DD and returns the end of the text.
+Years outside 0-9999 are written with as many digits as they need, up to 16 characters in all.
+*/
+char* TextFileLoad::_formatDate(int32_t days, char* out)
+{
+	int y, m, d;
+	_civilFromDays(days, y, m, d);
+	if(y >= 0 && y <= 9999)
+	{
+		_putDigits(out, y, 4);
+		out += 4;
 	}
+	else
+		out = to_chars(out, out + 8, y).ptr;
+	out[0] = '-';
+	_putDigits(out + 1, m, 2);
+	out[3] = '-';
+	_putDigits(out + 4, d, 2);
+	return out + 6;
 }
 
 /*
-Overloaded version for INTS.
+Writes a timestamp (microseconds since 1970-01-01 00:00:00 UTC) at out as YYYY-MM-DD HH:MM:SS,
+followed by .ffffff if the fraction of a second is not zero, and returns the end of the text.
+At most 30 characters are written.
 */
-void TextFileLoad::getField(int col_num, vector <int>& col_data)
+char* TextFileLoad::_formatTimestamp(int64_t micros, char* out)
 {
-	col_num--;
-	col_data.clear();
-
-	//Load the data into the vector, and do any necessary type conversions
-	switch(field_types[col_num])
+	int64_t seconds = micros / 1000000;
+	int64_t fraction = micros % 1000000;
+	if(fraction < 0)
 	{
-		case _VT_BOOL:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(data[i][col_num].vt_bool);
-			}
-			break;
-
-		case _VT_INT:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(data[i][col_num].vt_int);
-			}
-			break;
+		fraction += 1000000;
+		seconds--;
+	}
+	int64_t days = seconds / 86400;
+	int64_t day_seconds = seconds % 86400;
+	if(day_seconds < 0)
+	{
+		day_seconds += 86400;
+		days--;
+	}
 
-		case _VT_LONG:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back((int)data[i][col_num].vt_long);
-			}
-			break;
+	out = _formatDate((int32_t)days, out);
+	*out++ = ' ';
+	_putDigits(out, (int)(day_seconds / 3600), 2);
+	out[2] = ':';
+	_putDigits(out + 3, (int)(day_seconds / 60 % 60), 2);
+	out[5] = ':';
+	_putDigits(out + 6, (int)(day_seconds % 60), 2);
+	out += 8;
+	if(fraction != 0)
+	{
+		*out++ = '.';
+		_putDigits(out, (int)fraction, 6);
+		out += 6;
+	}
+	return out;
+}
 
-		case _VT_DOUBLE:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back((int)data[i][col_num].vt_double);
-			}
-			break;
+/////////////////////////////////////////////////////////////////////////////
+// TEXT ENCODINGS
+/////////////////////////////////////////////////////////////////////////////
 
-		case _VT_STRING:
-			//If the data is a string, just push back 0's.
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(0);
-			}
+/*
+Writes code point cp as UTF-8 at out, and returns the position after it.
+*/
+static char* _putUtf8(uint32_t cp, char* out)
+{
+	if(cp < 0x80)
+		*out++ = (char)cp;
+	else if(cp < 0x800)
+	{
+		*out++ = (char)(0xC0 | (cp >> 6));
+		*out++ = (char)(0x80 | (cp & 0x3F));
 	}
+	else if(cp < 0x10000)
+	{
+		*out++ = (char)(0xE0 | (cp >> 12));
+		*out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+		*out++ = (char)(0x80 | (cp & 0x3F));
+	}
+	else
+	{
+		*out++ = (char)(0xF0 | (cp >> 18));
+		*out++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+		*out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+		*out++ = (char)(0x80 | (cp & 0x3F));
+	}
+	return out;
 }
 
 /*
-Overloaded version for LONGS.
+Determines the encoding of the file from the user's setting, its byte order mark and its bytes,
+and sets text_start past the byte order mark. Without a byte order mark, a file whose first bytes
+are zero at every other position, as ASCII is in UTF-16, is UTF-16, and any other file is taken
+to be UTF-8 until a row that is not valid UTF-8 is parsed (see _checkEncoding()).
 */
-void TextFileLoad::getField(int col_num, vector <long>& col_data)
+_ENC_TYPE TextFileLoad::_detectEncoding(void)
 {
-	col_num--;
-	col_data.clear();
+	vector<char> head(4096);
+	in_stream.clear();
+	in_stream.seekg(0, ios::beg);
+	in_stream.read(&head[0], head.size());
+	size_t n = in_stream.gcount();
+	const unsigned char* bytes = (const unsigned char*)&head[0];
 
-	//Load the data into the vector, and do any necessary type conversions
-	switch(field_types[col_num])
-	{
-		case _VT_BOOL:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(data[i][col_num].vt_bool);
-			}
-			break;
+	bool utf8_bom = (n >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF);
+	bool le_bom = (n >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE);
+	bool be_bom = (n >= 2 && bytes[0] == 0xFE && bytes[1] == 0xFF);
 
-		case _VT_INT:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(data[i][col_num].vt_int);
-			}
-			break;
+	_ENC_TYPE detected = encoding;
+	if(detected == _ENC_AUTO)
+	{
+		size_t even_zeros = 0, odd_zeros = 0;
+		for(size_t i = 0; i + 1 < n; i += 2)
+		{
+			even_zeros += (bytes[i] == 0);
+			odd_zeros += (bytes[i + 1] == 0);
+		}
+		if(utf8_bom)
+			detected = _ENC_UTF8;
+		else if(le_bom || (odd_zeros * 4 > n / 2 && even_zeros * 8 < odd_zeros))
+			detected = _ENC_UTF16LE;
+		else if(be_bom || (even_zeros * 4 > n / 2 && odd_zeros * 8 < even_zeros))
+			detected = _ENC_UTF16BE;
+		else
+			detected = _ENC_UTF8;
+	}
 
-		case _VT_LONG:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(data[i][col_num].vt_long);
-			}
-			break;
+	if(detected == _ENC_UTF8 && utf8_bom)
+		text_start = 3;
+	else if((detected == _ENC_UTF16LE && le_bom) || (detected == _ENC_UTF16BE && be_bom))
+		text_start = 2;
 
-		case _VT_DOUBLE:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back((long)data[i][col_num].vt_double);
-			}
-			break;
+	in_stream.clear();
+	return detected;
+}
 
-		case _VT_STRING:
-			//If the data is a string, just push back 0's.
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(0);
-			}
-	}
+/*
+Checks that a row of a file taken to be UTF-8 is valid UTF-8, and switches to Latin-1 at the
+first row that is not. Also notes whether a row with non-ASCII UTF-8 text was read before that.
+*/
+void TextFileLoad::_checkEncoding(const string& row)
+{
+	const unsigned char* text = (const unsigned char*)row.data();
+	size_t n = row.length();
+	if(_validUtf8(text, n) < n)
+		_useLatin1();
+	else if(!utf8_rows)
+		utf8_rows = (find_if(text, text + n, [](unsigned char c) { return c >= 0x80; }) != text + n);
 }
 
 /*
-Overloaded version for DOUBLES.
+Reads the file as Latin-1 from now on. Rows already read as UTF-8 with non-ASCII text mean that
+the file mixes both encodings, which is reported.
 */
-void TextFileLoad::getField(int col_num, vector <double>& col_data)
+void TextFileLoad::_useLatin1(void)
 {
-	col_num--;
-	col_data.clear();
+	if(utf8_rows)
+		printf("\nWARNING: %s mixes UTF-8 and Latin-1 text! It is read as Latin-1.\n", filename.c_str());
+	encoding = _ENC_LATIN1;
+	check_utf8 = false;
+	latin1_text = true;
+}
 
-	//Load the data into the vector, and do any necessary type conversions
-	switch(field_types[col_num])
+/*
+Converts fields from Latin-1 to UTF-8 in place. Fields that are ASCII are left as they are.
+*/
+void TextFileLoad::_latin1Fields(vector<string>& fields) const
+{
+	string converted;
+	for(size_t i = 0; i < fields.size(); i++)
 	{
-		case _VT_BOOL:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(data[i][col_num].vt_bool);
-			}
-			break;
-
-		case _VT_INT:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(data[i][col_num].vt_int);
-			}
-			break;
-
-		case _VT_LONG:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(data[i][col_num].vt_long);
-			}
-			break;
-
-		case _VT_DOUBLE:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(data[i][col_num].vt_double);
-			}
-			break;
-
-		case _VT_STRING:
-			//If the data is a string, just push back 0's.
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(0.0);
-			}
+		const unsigned char* text = (const unsigned char*)fields[i].data();
+		size_t n = fields[i].length();
+		size_t ascii = find_if(text, text + n, [](unsigned char c) { return c >= 0x80; }) - text;
+		if(ascii == n)
+			continue;
+		converted.resize(ascii + (n - ascii) * 2);
+		char* pos = &converted[0] + ascii;
+		memcpy(&converted[0], text, ascii);
+		for(size_t k = ascii; k < n; k++)
+			pos = _putUtf8(text[k], pos);
+		converted.resize(pos - &converted[0]);
+		fields[i].swap(converted);
 	}
 }
 
 /*
-Overloaded version for STRINGS.
+Converts the file from UTF-16 to UTF-8, from text_start on, into a temporary file in
+spill_directory, and switches in_stream and input_file to it. The file is converted in blocks, so
+that memory use does not depend on its size. UTF-16 code units that are not part of a valid
+surrogate pair become U+FFFD.
 */
-void TextFileLoad::getField(int col_num, vector <string>& col_data)
+void TextFileLoad::_transcodeFile(void)
 {
-	col_num--;
-	col_data.clear();
-
-	//Load the data into the vector, and do any necessary type conversions
-	switch(field_types[col_num])
+	string path = spill_directory + "/tfltext_XXXXXX";
+	vector<char> path_buf(path.begin(), path.end());
+	path_buf.push_back('\0');
+	int fd = mkstemp(&path_buf[0]);
+	if(fd < 0)
 	{
-		char conv[14]; //For converting non-string data.
+		printf("\n\nERROR: temporary file in %s failed to open!\n\n", spill_directory.c_str());
+		exit(1);
+	}
+	close(fd);
+	ofstream out(&path_buf[0], ios::out | ios::binary | ios::trunc);
 
-		case _VT_BOOL:
-			for(int i = 0; i < row_count; i ++)
-			{
-				snprintf(conv, sizeof(conv), "%d",data[i][col_num].vt_bool);
-				col_data.push_back(conv);
-			}
-			break;
+	//Each UTF-16 code unit becomes at most three bytes of UTF-8
+	const size_t block_size = 1 << 20;
+	vector<char> block(block_size + 1);
+	vector<char> converted(block_size * 2 + 8);
+	size_t carried = 0;
+	uint32_t high_surrogate = 0;
+	bool little_endian = (encoding == _ENC_UTF16LE);
+	in_stream.clear();
+	in_stream.seekg(text_start, ios::beg);
+	while(true)
+	{
+		in_stream.read(&block[carried], block_size);
+		size_t n = carried + in_stream.gcount();
+		bool last = (n == carried);
+		const unsigned char* bytes = (const unsigned char*)&block[0];
+		char* pos = &converted[0];
 
-		case _VT_INT:
-			for(int i = 0; i < row_count; i ++)
+		size_t i = 0;
+		for(; i + 1 < n; i += 2)
+		{
+			uint32_t unit = little_endian ? (bytes[i] | (bytes[i + 1] << 8)) : ((bytes[i] << 8) | bytes[i + 1]);
+			if(high_surrogate != 0)
 			{
-				snprintf(conv, sizeof(conv), "%d",data[i][col_num].vt_int);
-				col_data.push_back(conv);
+				if(unit >= 0xDC00 && unit <= 0xDFFF)
+				{
+					pos = _putUtf8(0x10000 + ((high_surrogate - 0xD800) << 10) + (unit - 0xDC00), pos);
+					high_surrogate = 0;
+					continue;
+				}
+				pos = _putUtf8(0xFFFD, pos);
+				high_surrogate = 0;
 			}
-			break;
+			if(unit >= 0xD800 && unit <= 0xDBFF)
+				high_surrogate = unit;
+			else if(unit >= 0xDC00 && unit <= 0xDFFF)
+				pos = _putUtf8(0xFFFD, pos);
+			else
+				pos = _putUtf8(unit, pos);
+		}
 
-		case _VT_LONG:
-			for(int i = 0; i < row_count; i ++)
-			{
-				snprintf(conv, sizeof(conv), "%ld",data[i][col_num].vt_long);
-				col_data.push_back(conv);
-			}
-			break;
+		//An odd byte waits for the next block; at the end of the file it is dropped
+		carried = n - i;
+		if(carried > 0)
+			block[0] = block[i];
+		if(last && high_surrogate != 0)
+			pos = _putUtf8(0xFFFD, pos);
 
-		case _VT_DOUBLE:
-			for(int i = 0; i < row_count; i ++)
-			{
-				snprintf(conv, sizeof(conv), "%f",data[i][col_num].vt_double);
-				col_data.push_back(conv);
-			}
+		out.write(&converted[0], pos - &converted[0]);
+		if(last)
 			break;
+	}
+	if(!out)
+	{
+		printf("\n\nERROR: failed to write temporary file %s!\n\n", &path_buf[0]);
+		exit(1);
+	}
+	out.close();
 
-		case _VT_STRING:
-			for(int i = 0; i < row_count; i ++)
-			{
-				col_data.push_back(data[i][col_num].vt_string);
-			}
+	in_stream.close();
+	in_stream.clear();
+	input_file = &path_buf[0];
+	in_stream.open(input_file.c_str(), ios::in | ios::binary);
+	if(!in_stream)
+	{
+		printf("\n\nERROR: file failed to open!\n\n");
+		exit(1);
 	}
+	text_start = 0;
 }
@@ -16,6 +16,7 @@
 /////////////////////////////////////////////////////////////////////////////
 //
 // TextFileLoad is an ANSI-compliant class that allows a user to easily import a text file.
+// It requires a C++17 compiler with thread support (e.g., g++ -std=c++17 -pthread).
 // Data can be loaded by column name or number. Loading by name is advantageous because it
 // allows the order of the columns in the input file to change without any subsequent
 // effect on the analysis.
@@ -25,12 +26,84 @@
 // conversion (e.g., loading a column of strings into a vector of booleans),
 // the data are converted to 0's.
 //
+// Columns of ISO 8601 dates (2024-03-15) and timestamps (2024-03-15 10:30:00, optionally with
+// a fraction of a second and a time zone) are detected as DATE and TIMESTAMP columns. They are
+// stored as days since 1970-01-01 and microseconds since 1970-01-01 00:00:00 UTC, which is what
+// loading them into a vector of ints, longs or doubles returns. Loading them into a vector of
+// strings returns them in ISO 8601 form. As with numbers, nulls are stored as 0 (1970-01-01).
+//
 // USER OPTIONS
 // There are several options available to the user when importing the data:
 // 1) delimiter (default is tab-delimited)
 // 2) header row (default assumes first row is the header row)
 // 3) Load by column number or column name
 //		--If loading by column name, user can specify case sensitivity (default is no case sensitivity)
+// 4) Schema (default is to infer the type of each column from the data)
+//		--Types can be declared by column position or by column name via TextFileLoadOptions.
+//		  Type inference is then skipped entirely. Values that do not fit the declared type
+//		  are stored as null (0 or blank), counted, and reported by getTypeMismatches().
+// 5) Compact storage (default is off)
+//		--Set TextFileLoadOptions::compact to store each numeric column in the smallest exact
+//		  width (bits, int8, int16, int32, int64, float). getStorageBytes() reports the result.
+//		  BOOLEAN columns are always stored as bits.
+// 6) Row selection (default is to load all rows)
+//		--A range of rows (first_row/max_rows), the last N rows (negative first_row), or a random
+//		  sample of rows (sample_rows) can be loaded without parsing the rest of the file.
+//		--A row-offset index, built while loading (index_stride) or later (buildRowIndex), can be
+//		  saved next to the file (saveRowIndex) so that later loads that name it (index_file) seek
+//		  straight to their rows.
+//		  getChunkOffsets() uses it to split the file into row-aligned chunks for parallel work.
+// 7) Memory budget (default is no limit)
+//		--Set TextFileLoadOptions::memory_budget to cap the memory used by the loaded columns.
+//		  Data beyond the budget is spilled to temporary files, during loading in chunks and
+//		  afterwards by evicting the least recently used columns. A spilled column is streamed
+//		  back from its file when it is next used. The budget must hold the largest column in
+//		  use. It bounds the memory of the columns held by the object, not the copies returned
+//		  by getField(), which belong to the caller.
+// 8) Row visitor (default is to store the data)
+//		--Set TextFileLoadOptions::visitor to receive the rows in batches of typed columns straight
+//		  from the parser, for single-pass processing without storing the data.
+// 9) Fixed-width files (default is a delimited file)
+//		--Set TextFileLoadOptions::fixed_width to a layout of (name, start, length) fields to cut
+//		  each record by position. Type inference, storage and getField() work as for delimited
+//		  files. If all records have the same length, they are parsed in parallel.
+// 10) Sampled type inference (default reads every selected row to infer the types)
+//		--Set TextFileLoadOptions::infer_rows to infer the types from that many rows: the first
+//		  ones and random stripes of the file. A later value that does not fit its column's type
+//		  promotes the column in place (e.g. int to double to string), so the loaded values are
+//		  the same as with full inference. getTypePromotions() reports the promotions.
+// 11) Text encoding (default detects it)
+//		--A UTF-8 byte order mark is skipped, and UTF-16 files (with a byte order mark, or mostly
+//		  ASCII without one) are recognized and converted to a temporary UTF-8 copy. Other files
+//		  are read as UTF-8 and checked row by row as they are parsed: at the first row that is
+//		  not valid UTF-8, the file is read as Latin-1 from there on, with a warning if rows that
+//		  were read before it held UTF-8. Latin-1 fields are converted to UTF-8 as they are split.
+//		  getEncoding() reports the result. Set TextFileLoadOptions::encoding to skip detection.
+//
+//
+// AGGREGATION
+// aggregate() groups the rows by one or more key columns and returns the count, sum, mean, min
+// and max of one or more value columns for each group. Large datasets are aggregated in parallel.
+//
+//
+// SORTING
+// getSortedIndex() returns the row permutation that sorts the data by one or more key columns.
+// sortRows() reorders the data by such a permutation, and findSortedRange() binary-searches it
+// for the rows whose first key equals a given value.
+//
+//
+// BOOLEAN COLUMNS
+// BOOLEAN columns are stored as bitmaps, 64 rows per word. getBitmap() returns a copy of one, and
+// andBits(), orBits() and notBits() combine them a word at a time, so that filters on many flags
+// are cheap. countBits() counts the rows that are set, and getSelection() lists them.
+//
+//
+// JOINS
+// The join constructor builds a new dataset from two loaded ones by matching a key column of
+// each: every column of the left dataset followed by every column of the right dataset except
+// its key. The inner join keeps matched rows only; with keep_unmatched set (a left join), left
+// rows without a match are kept with nulls in the right columns. Rows are in left row order.
+// Keys are compared as integers, as numbers, or (if either key is a string column) as strings.
 //
 //
 // EXAMPLE CLASS INITIALIZATIONS
@@ -38,12 +111,51 @@
 //		2. (csv file): TextFileLoad TFLobj("sample text.csv", ",");
 //		3. (tab file, no header row): TextFileLoad TFLobj("sample text.tab", false);
 //		4. (csv file, no header row): TextFileLoad TFLobj("sample text.csv", ",", false);
+//		5. (tab file, declared schema):
+//				TextFileLoadOptions opts;
+//				opts.schema_by_name["Year"] = _VT_INT;
+//				opts.schema_by_name["double data"] = _VT_DOUBLE;
+//				TextFileLoad TFLobj("sample text.tab", opts);
+//		6. (rows 1000 to 1999 of a tab file):
+//				TextFileLoadOptions opts;
+//				opts.first_row = 1000;
+//				opts.max_rows = 1000;
+//				TextFileLoad TFLobj("sample text.tab", opts);
+//		7. (inner join of two loaded files on their "id" columns): TextFileLoad joined(TFLobj1, TFLobj2, "id", "id");
+//		8. (fixed-width file with a 4-character year and a 10-character code, no header row):
+//				TextFileLoadOptions opts;
+//				opts.header_row = false;
+//				opts.fixed_width.push_back(fixed_width_field("Year", 0, 4));
+//				opts.fixed_width.push_back(fixed_width_field("Code", 4, 10));
+//				TextFileLoad TFLobj("sample text.dat", opts);
+//		9. (shared, read-only tab file): TextFileLoadHandle data = TextFileLoad::loadShared("sample text.tab");
+//
+//
+// THREAD SAFETY
+// All const methods (getField(), aggregate(), getSortedIndex(), findSortedRange(), the getters, and
+// the join constructor, which reads its inputs) may be called from any number of threads at once.
+// In memory budget mode they serialize on an internal lock, since reading a spilled column moves
+// data in and out of memory. The non-const methods (takeField(), sortRows(), buildRowIndex(),
+// saveRowIndex(), getChunkOffsets()) must not run at the same time as any other call.
+// loadShared() loads a file into a TextFileLoadHandle, a shared_ptr to a const TextFileLoad, which
+// can be copied freely between threads and frees the data when the last copy is released.
+//
+//
+// takeField() works like getField(), but moves the column out of the object instead of copying
+// it and releases the column's memory at once. The column cannot be loaded again afterwards.
+// When the vector type matches the storage type (e.g., a column of strings into a vector of
+// strings, or a column of doubles into a vector of doubles), no data is copied at all.
 //
 //
 // EXAMPLE DATA LOADS
 //		1. (load "var1" column, no case sensitivity): TFLobj.getField("var1",my_vector);
 //		2. (load "var2" column, case sensitive): TFLobj.getField("var1",my_vector, true);
 //		3. (load third column of data): TFLobj.getField(3,my_vector);
+//		4. (move "var1" column out, freeing its memory): TFLobj.takeField("var1",my_vector);
+//		5. (sum of "var2" by "var1"): aggregate_result r = TFLobj.aggregate(vector<string>(1,"var1"), vector<string>(1,"var2"));
+//		6. (rows where "flag1" and not "flag2" are set):
+//				vector<uint64_t> bits = TFLobj.andBits(TFLobj.getBitmap("flag1"), TFLobj.notBits(TFLobj.getBitmap("flag2")));
+//				vector<long> rows = TFLobj.getSelection(bits);
 //
 //
 // KNOWN ISSUES
@@ -67,82 +179,423 @@
 #include <vector>
 #include <fstream>
 #include <cstdlib>
+#include <map>
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <functional>
 
 using namespace std;
 
 //Enumeration is used as a value label for data types
-enum _VT_TYPE {_VT_INT, _VT_LONG, _VT_DOUBLE, _VT_BOOL, _VT_STRING};
+enum _VT_TYPE {_VT_INT, _VT_LONG, _VT_DOUBLE, _VT_BOOL, _VT_STRING, _VT_DATE, _VT_TIMESTAMP};
+
+//Enumeration is used as a value label for the storage width of a column
+enum _ST_TYPE {_ST_BIT, _ST_INT8, _ST_INT16, _ST_INT32, _ST_INT64, _ST_FLOAT, _ST_DOUBLE, _ST_STRING};
+
+//Enumeration is used as a value label for the text encoding of a file
+enum _ENC_TYPE {_ENC_AUTO, _ENC_UTF8, _ENC_LATIN1, _ENC_UTF16LE, _ENC_UTF16BE};
 
 /*
-CREATE VARIANT STRUCTURE
-This structure, a simplified version of _variant_t, allows all types of data to be
-held in one single object.
+CREATE COLUMN STRUCTURE
+This structure holds all the values of one column in a single contiguous vector. There is one
+property per storage type, and only the one named by st_type holds the data.
 */
-struct variant
+struct column
 {
-	bool vt_bool;
-	int vt_int;
-	long vt_long;
-	double vt_double;
-	string vt_string;
-
-	//vt_type specifies which of the above properties holds a valid value of interest
-	_VT_TYPE vt_type;
+	vector<uint64_t> st_bit;	//bools, packed 64 per word
+	vector<int8_t> st_int8;
+	vector<int16_t> st_int16;
+	vector<int32_t> st_int32;
+	vector<int64_t> st_int64;
+	vector<float> st_float;
+	vector<double> st_double;
+	vector<string> st_string;
+
+	//st_type specifies which of the above properties holds the column data
+	_ST_TYPE st_type;
+
+	//In memory budget mode, the first spill_rows values may have been moved to the temporary
+	//file spill_file, in which case the property above only holds the values after them.
+	string spill_file;
+	long spill_rows;
+
+	column(void) : st_type(_ST_STRING), spill_rows(0) {}
 };
 
+class TextFileLoadVisitor;
+
+/*
+FIXED-WIDTH FIELD
+Position of one field in the records of a fixed-width file: length characters starting at start
+(0-based) within the record.
+*/
+struct fixed_width_field
+{
+	string name;
+	long start;
+	long length;
+
+	fixed_width_field(string field_name="", long field_start=0, long field_length=0)
+		: name(field_name), start(field_start), length(field_length) {}
+};
+
+/*
+LOAD OPTIONS
+Collects the settings used by the TextFileLoad(string, TextFileLoadOptions) constructor. The
+defaults match those of the other constructors.
+*/
+struct TextFileLoadOptions
+{
+	char delimiter;
+	bool header_row;
+
+	//User-supplied schema. If either of these is non-empty, type inference is skipped and each
+	//value is parsed straight into its declared type. Columns not named in schema_by_name are
+	//loaded as strings. Names are not case sensitive and require a header row.
+	vector<_VT_TYPE> schema;				//one type per column, in column order
+	map<string, _VT_TYPE> schema_by_name;	//column name -> type
+
+	//Compact mode. After loading, each numeric column is stored in the smallest width that holds
+	//all of its values exactly: bools as bits, integers as int8/int16/int32/int64, and doubles
+	//as float when every value survives the round trip.
+	bool compact;
+
+	//Row selection. By default all rows are loaded. Type inference only looks at the selected rows.
+	long first_row;				//0-based first data row to load; negative counts back from the end (-10 = last 10 rows)
+	long max_rows;				//maximum number of rows to load; -1 loads all remaining rows
+	long sample_rows;			//if > 0, load this many distinct rows chosen at random, in file order
+	unsigned int sample_seed;	//seed for sample_rows
+
+	//Row-offset index. An index records the byte offset of every index_stride-th data row, so that
+	//selected rows can be reached with a seek instead of a scan. If index_file is set to an index
+	//saved by saveRowIndex(), it is used for row selection, unless the text file has changed since.
+	//It is checked against the size and modification time of the file and a sample of its rows.
+	long index_stride;			//if > 0, build an index while loading the whole file
+	string index_file;
+
+	//Memory budget. If > 0, column data beyond this many bytes is spilled to temporary files in
+	//spill_directory (default: $TMPDIR or /tmp) and streamed back when it is used. Vectors filled
+	//by getField() are the caller's and are not counted, so peak memory use is the budget plus the
+	//columns copied out at the same time (and a small read buffer).
+	long memory_budget;
+	string spill_directory;
+
+	//Row visitor. If set, the selected rows are passed to visitor in batches of batch_rows rows as
+	//they are parsed, and are not stored. The object then only holds the field names, field types
+	//and row count. Type inference still reads the rows first unless a schema is declared.
+	TextFileLoadVisitor* visitor;
+	long batch_rows;
+
+	//Fixed-width layout. If non-empty, each record is cut into these fields by position instead of
+	//being split at the delimiter, and the spaces that pad each field are trimmed. The field names
+	//come from the layout; with header_row set, the first line is skipped.
+	vector<fixed_width_field> fixed_width;
+
+	//Sampled type inference. If infer_rows > 0, the types are inferred from the first infer_rows/2
+	//selected rows and from infer_stripes runs of rows starting at random points of the file
+	//(seeded by sample_seed), instead of from all the selected rows. Columns are promoted to a
+	//wider type while loading if a value does not fit.
+	long infer_rows;
+	int infer_stripes;
+
+	//Text encoding. _ENC_AUTO detects UTF-16 from the byte order mark or the first bytes of the
+	//file, and tells UTF-8 from Latin-1 by checking the rows as they are parsed. UTF-16 files are
+	//converted to a UTF-8 copy in spill_directory before they are parsed.
+	_ENC_TYPE encoding;
+
+	TextFileLoadOptions(char delimit='\t', bool headers=true) : delimiter(delimit), header_row(headers), compact(false),
+		first_row(0), max_rows(-1), sample_rows(0), sample_seed(1), index_stride(0), memory_budget(0),
+		visitor(NULL), batch_rows(65536), infer_rows(0), infer_stripes(8), encoding(_ENC_AUTO) {}
+};
+
+/*
+ROW BATCH
+Passed to TextFileLoadVisitor::visitBatch(). columns[c] holds the values of column c for rows
+first_row to first_row+row_count-1 of the selected rows, in the storage type of its field type:
+BOOL in st_int8, INT in st_int32, LONG in st_int64, DOUBLE in st_double, STRING in st_string,
+DATE in st_int32 (days since 1970-01-01) and TIMESTAMP in st_int64 (microseconds since
+1970-01-01 00:00:00 UTC).
+The vectors are reused for a later batch once visitBatch() returns, so values that must outlive
+the call have to be copied.
+With sampled type inference, a column can be promoted to a wider type by a later batch, so
+field_types gives the types of this batch's columns.
+*/
+struct row_batch
+{
+	long first_row;
+	long row_count;
+	vector<_VT_TYPE> field_types;
+	vector<column> columns;
+};
+
+/*
+ROW VISITOR
+Base class for single-pass consumers of a file (see TextFileLoadOptions::visitor). visitFields()
+is called once with the field names and types, and then visitBatch() once per batch of rows, in
+row order, on the thread that constructs the TextFileLoad object. The next batch is parsed on
+another thread in the meantime.
+*/
+class TextFileLoadVisitor
+{
+public:
+	virtual ~TextFileLoadVisitor(void) {}
+	virtual void visitFields(const vector<string>& /*field_names*/, const vector<string>& /*field_types*/) {}
+	virtual void visitBatch(const row_batch& batch) = 0;
+};
+
+/*
+LOAD TIMINGS
+Returned by TextFileLoad::getLoadTimings(). Wall-clock seconds spent in each phase of loading a
+file: opening it (with encoding detection and conversion) and reading the header, selecting the
+rows and inferring or applying the types, parsing the rows into columns (or passing them to a
+visitor), and building the requested index and compacting the columns.
+*/
+struct load_timings
+{
+	double open_seconds;
+	double types_seconds;
+	double parse_seconds;
+	double finish_seconds;
+
+	load_timings(void) : open_seconds(0), types_seconds(0), parse_seconds(0), finish_seconds(0) {}
+};
+
+/*
+AGGREGATION RESULT
+Returned by TextFileLoad::aggregate(). Groups appear in the order in which their first row
+appears in the data. Statistics are indexed first by value column and then by group.
+*/
+struct aggregate_result
+{
+	vector<string> key_names;
+	vector<string> value_names;
+	vector< vector<string> > keys;	//keys[k][g] is the value of key column k for group g
+	vector<long> first_row;			//first data row (0-based) of each group
+	vector<long> count;				//number of rows in each group
+	vector< vector<double> > sum;
+	vector< vector<double> > mean;
+	vector< vector<double> > min;
+	vector< vector<double> > max;
+};
+
+class TextFileLoad;
+
+//Shared, reference-counted handle to a loaded dataset that can no longer be modified
+typedef shared_ptr<const TextFileLoad> TextFileLoadHandle;
+
 class TextFileLoad
 {
+	//TextFileWrite writes loaded columns straight from their storage
+	friend class TextFileWrite;
 
 private:
 	//PRIVATE MEMBERS
 	char delimiter;
 	bool header_row;
 	string filename;
+	string input_file; // File that is parsed: filename, or its UTF-8 copy if it had to be converted
+	_ENC_TYPE encoding; // Encoding of filename
+	bool check_utf8; // Check each row for UTF-8 validity, and switch to Latin-1 at the first invalid one
+	bool latin1_text; // Convert the fields from Latin-1 to UTF-8 as they are split
+	bool utf8_rows; // A row with valid non-ASCII UTF-8 was read since the last rewind
+	int64_t text_start; // Byte offset of the text in input_file, after any byte order mark
 	vector<string> field_names;
 	vector<_VT_TYPE> field_types;
+	vector<string> field_type_names; // field_types as returned by getFieldTypes()
+	vector<bool> field_taken; // True for columns whose storage was moved out by takeField()
+	bool data_visited; // True if the rows were passed to a visitor instead of being stored
+	vector<fixed_width_field> fixed_fields; // Fixed-width layout, empty for delimited files
+	int64_t record_length; // Length of every fixed-width record, line break included, or 0 if they differ
 	ifstream in_stream;
-	vector < vector <variant> > data;
+	mutable vector<column> columns; // Spilled columns are read back by const methods
 	long field_count;
 	long row_count;
 	int offset; // Determined by end-of-line formatting for text file. Used by _splitString.
+	bool use_schema; // True if the user declared the column types
+	vector<long> type_mismatches; // Per column count of values that did not fit the declared type
+	vector<long> type_promotions; // Per column count of promotions to a wider type while loading
+	load_timings timings; // Time spent in each phase of loading the file
+	bool sampled_types; // True if the types were inferred from a sample of the rows
+	vector<char> inferred_values; // Per column, true if type inference saw a non-empty value
+	int64_t data_start; // Byte offset of the first data row
+	int64_t file_size;
+
+	//Row-offset index: byte offset of every index_stride-th data row, covering index_rows rows
+	vector<int64_t> row_index;
+	long index_stride;
+	long index_rows;
+
+	//Rows to load, as runs of count (-1 = to end of file) rows starting skip rows after offset.
+	//row is the number of the first row in the run, or -1 if unknown.
+	struct row_range
+	{
+		int64_t offset;
+		long skip;
+		long count;
+		int64_t row;
+	};
+	vector<row_range> row_ranges;
+
+	//State of a load in progress: the current type of each column, which starts as the inferred
+	//type and can be widened by values the inference sample did not see, and what was counted.
+	//A column promoted to string holds blank placeholders for its first text_rows rows.
+	struct parse_state
+	{
+		vector<_VT_TYPE> types;
+		vector<char> has_value;
+		vector<long> mismatches;
+		vector<long> promotions;
+		vector<long> text_rows;
+		long rows;
+		bool check_types;
+	};
+
+	//Position of _nextRow() within row_ranges and within the file
+	size_t range_pos;
+	long range_remaining;
+	int64_t stream_pos;
+	int64_t current_row;
+	int64_t last_row_offset;
+
+	//Memory budget state: resident bytes and last use of each column, for LRU spilling. It changes
+	//on reads, so it is mutable and guarded by column_mutex.
+	long memory_budget;
+	string spill_directory;
+	mutable vector<int64_t> column_bytes;
+	mutable vector<long> column_last_used;
+	mutable long use_clock;
+	mutable recursive_mutex column_mutex;
 
 	//PRIVATE METHODS
+	void _init(string textfile, const TextFileLoadOptions& opts);
 	void _openFile(void);
+	_ENC_TYPE _detectEncoding(void);
+	void _checkEncoding(const string& row);
+	void _useLatin1(void);
+	void _latin1Fields(vector<string>& fields) const;
+	void _transcodeFile(void);
 	void _getFieldNames(void);
 	void _getFieldTypes(void);
+	void _sampleFieldTypes(long infer_rows, int stripes, unsigned int seed);
+	void _getRecordLength(void);
+	void _splitRow(const string& row, vector<string>& split_row);
+	void _sliceFields(const char* record, size_t len, vector<string>& split_row) const;
+	bool _parallelRecords(unsigned& workers) const;
+	bool _scanRecords(int64_t first, int64_t last, const function<void(vector<string>&)>& visit, char& invalid_text) const;
+	void _setFieldTypeNames(void);
+	void _applySchema(const TextFileLoadOptions& opts);
+	void _selectRows(const TextFileLoadOptions& opts);
+	void _rewindRows(void);
+	void _seekRange(const row_range& range);
+	bool _nextRow(string& row);
+	int64_t _findTailOffset(long rows);
+	bool _loadRowIndex(string index_file);
+	void _rowIndexHeader(int64_t header[6]);
+	int64_t _initColumns(vector<column>& cols, const vector<_VT_TYPE>& types);
+	parse_state _newParseState(void);
+	int64_t _appendRow(vector<string>& split_row, vector<column>& cols, parse_state& state);
+	void _promoteColumn(column& col, _VT_TYPE from, _VT_TYPE to);
+	void _restoreText(const vector<long>& text_rows);
+	void _restoreRow(vector<column>& cols, const vector<long>& text_rows, long row, vector<string>& split_row);
+	void _finishParse(const parse_state& state);
+	void _reportMismatches(void);
 	void _getData(void);
-	int _getColNum(string column_name, bool case_sensitive);
+	bool _getDataParallel(unsigned workers);
+	void _visitData(TextFileLoadVisitor& visitor, long batch_rows);
+	void _compactColumn(column& col);
+	void _checkBitmap(const vector<uint64_t>& bits) const;
+	template <typename T> void _getColumn(int col_num, vector<T>& col_data) const;
+	template <typename T> void _takeColumn(int col_num, vector<T>& col_data);
+	void _keyCodes(int col_num, vector<int64_t>& codes) const;
+	void _sortKeys(int col_num, bool ascending, vector<uint64_t>& keys) const;
+	void _gatherColumn(const column& src, const vector<long>& rows, column& dst);
+	column& _residentColumn(int col_num) const;
+	void _spillColumn(int col_num) const;
+	void _makeRoom(int64_t bytes, int keep_col) const;
+	int64_t _columnBytes(const column& col) const;
+	unique_lock<recursive_mutex> _lockColumns(void) const;
+	void _join(const TextFileLoad& left, const TextFileLoad& right, int left_col, int right_col, bool keep_unmatched);
+	int _getColNum(string column_name, bool case_sensitive) const;
 	vector<string> _splitString(string str, char delimit); //This method needs to be modified if running under Windows
 	string _trim(string str);
-	string _toUpper(string str);
+	string _toUpper(string str) const;
 	int _getType(string str);
 	bool _isDouble(string str);
 	bool _isLong(string str);
+	static bool _parseDate(const char* first, const char* last, int32_t& days);
+	static bool _parseTimestamp(const char* first, const char* last, int64_t& micros);
+	static char* _formatDate(int32_t days, char* out);
+	static char* _formatTimestamp(int64_t micros, char* out);
+	static int64_t _integerAt(const column& col, long row);
 
 public:
 	//CONSTRUCTORS AND DESTRUCTOR
 	TextFileLoad(string textfile, bool header_row=true);
 	TextFileLoad(string textfile, char delimit, bool header_row=true);
+	TextFileLoad(string textfile, const TextFileLoadOptions& opts);
+	TextFileLoad(const TextFileLoad& left, const TextFileLoad& right, string left_key, string right_key, bool keep_unmatched=false, bool case_sensitive=false);
 	~TextFileLoad(void);
+	static TextFileLoadHandle loadShared(string textfile, const TextFileLoadOptions& opts=TextFileLoadOptions());
 
 	//PUBLIC METHODS
-	vector<string> getFieldNames(void);
-	vector<string> getFieldTypes(void);
-	bool existsFieldName(string name, bool case_sensitive=false);
-	long getFieldCount(void);
-	long getRowCount(void);
+	const vector<string>& getFieldNames(void) const;
+	const vector<string>& getFieldTypes(void) const;
+	bool existsFieldName(string name, bool case_sensitive=false) const;
+	long getFieldCount(void) const;
+	long getRowCount(void) const;
+	vector<long> getTypeMismatches(void) const;
+	vector<long> getTypePromotions(void) const;
+	vector<string> getStorageTypes(void) const;
+	long getStorageBytes(void) const;
+	string getEncoding(void) const;
+	load_timings getLoadTimings(void) const;
+	//Row-offset index
+	void buildRowIndex(long stride=1024);
+	void saveRowIndex(string index_file="");
+	vector<int64_t> getRowIndex(void) const;
+	long getIndexStride(void) const;
+	vector<int64_t> getChunkOffsets(int chunk_count);
+	//Group-by aggregation
+	aggregate_result aggregate(const vector<string>& key_fields, const vector<string>& value_fields, bool case_sensitive=false) const;
+	//Sorting
+	vector<long> getSortedIndex(const vector<string>& key_fields, bool ascending=true, bool case_sensitive=false) const;
+	void sortRows(const vector<long>& order);
+	void findSortedRange(const vector<long>& order, string field_name, string value, long& first, long& last, bool case_sensitive=false) const;
+	//Boolean column bitmaps
+	vector<uint64_t> getBitmap(string field_name, bool case_sensitive=false) const;
+	vector<uint64_t> getBitmap(int col_num) const;
+	long countBits(const vector<uint64_t>& bits) const;
+	vector<uint64_t> andBits(const vector<uint64_t>& left, const vector<uint64_t>& right) const;
+	vector<uint64_t> orBits(const vector<uint64_t>& left, const vector<uint64_t>& right) const;
+	vector<uint64_t> notBits(const vector<uint64_t>& bits) const;
+	vector<long> getSelection(const vector<uint64_t>& bits) const;
 	//Overloaded getField methods
 	//1) get by field name
-	void getField(string field_name, vector <bool>& col_data, bool case_sensitive=false);
-	void getField(string field_name, vector <int>& col_data, bool case_sensitive=false);
-	void getField(string field_name, vector <long>& col_data, bool case_sensitive=false);
-	void getField(string field_name, vector <double>& col_data, bool case_sensitive=false);
-	void getField(string field_name, vector <string>& col_data, bool case_sensitive=false);
+	void getField(string field_name, vector <bool>& col_data, bool case_sensitive=false) const;
+	void getField(string field_name, vector <int>& col_data, bool case_sensitive=false) const;
+	void getField(string field_name, vector <long>& col_data, bool case_sensitive=false) const;
+	void getField(string field_name, vector <double>& col_data, bool case_sensitive=false) const;
+	void getField(string field_name, vector <string>& col_data, bool case_sensitive=false) const;
 	//2) get by column number
-	void getField(int col_num, vector <bool>& col_data);
-	void getField(int col_num, vector <int>& col_data);
-	void getField(int col_num, vector <long>& col_data);
-	void getField(int col_num, vector <double>& col_data);
-	void getField(int col_num, vector <string>& col_data);
+	void getField(int col_num, vector <bool>& col_data) const;
+	void getField(int col_num, vector <int>& col_data) const;
+	void getField(int col_num, vector <long>& col_data) const;
+	void getField(int col_num, vector <double>& col_data) const;
+	void getField(int col_num, vector <string>& col_data) const;
+	//Overloaded takeField methods, which move a column out and release its storage
+	//1) take by field name
+	void takeField(string field_name, vector <bool>& col_data, bool case_sensitive=false);
+	void takeField(string field_name, vector <int>& col_data, bool case_sensitive=false);
+	void takeField(string field_name, vector <long>& col_data, bool case_sensitive=false);
+	void takeField(string field_name, vector <double>& col_data, bool case_sensitive=false);
+	void takeField(string field_name, vector <string>& col_data, bool case_sensitive=false);
+	//2) take by column number
+	void takeField(int col_num, vector <bool>& col_data);
+	void takeField(int col_num, vector <int>& col_data);
+	void takeField(int col_num, vector <long>& col_data);
+	void takeField(int col_num, vector <double>& col_data);
+	void takeField(int col_num, vector <string>& col_data);
 };
 #endif
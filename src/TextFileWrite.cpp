@@ -0,0 +1,425 @@
+#include "TextFileWrite.h"
+#include <cstring>
+#include <charconv>
+#include <algorithm>
+#include <condition_variable>
+
+/////////////////////////////////////////////////////////////////////////////
+// HELPER FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+Makes room for at least n more bytes after the first used bytes of an output buffer.
+*/
+static inline char* _reserve(vector<char>& buf, size_t used, size_t n)
+{
+	if(used + n > buf.size())
+		buf.resize(max(buf.size() * 2, used + n));
+	return &buf[used];
+}
+
+/*
+Appends a number to an output buffer in its shortest exact form.
+*/
+template <typename A>
+static inline void _appendNumber(vector<char>& buf, size_t& used, A value)
+{
+	char* pos = _reserve(buf, used, 32); //Large enough for any int64 and any double in shortest form
+	used += to_chars(pos, pos + 32, value).ptr - pos;
+}
+
+/*
+Appends a string to an output buffer.
+*/
+static inline void _appendString(vector<char>& buf, size_t& used, const string& value)
+{
+	char* pos = _reserve(buf, used, value.length());
+	memcpy(pos, value.data(), value.length());
+	used += value.length();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CONSTRUCTORS
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+This constructor assumes a tab-delimited file. Default argument for headers is true.
+*/
+TextFileWrite::TextFileWrite(string textfile, bool headers)
+{
+	filename = textfile;
+	options = TextFileWriteOptions('\t', headers);
+}
+
+/*
+This constructor allows the user to specify the delimiter. Default argument for headers is true.
+*/
+TextFileWrite::TextFileWrite(string textfile, char delimit, bool headers)
+{
+	filename = textfile;
+	options = TextFileWriteOptions(delimit, headers);
+}
+
+/*
+This constructor takes all settings from a TextFileWriteOptions structure.
+*/
+TextFileWrite::TextFileWrite(string textfile, const TextFileWriteOptions& opts)
+{
+	filename = textfile;
+	options = opts;
+	if(options.chunk_rows <= 0)
+		options.chunk_rows = 65536;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// PRIVATE METHODS
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+Adds a user vector of the given type as the next output column.
+*/
+void TextFileWrite::_addVector(string name, _VT_TYPE type, const void* values, long rows)
+{
+	out_field field;
+	field.name = name;
+	field.source = NULL;
+	field.col_num = -1;
+	field.type = type;
+	field.values = values;
+	field.rows = rows;
+	fields.push_back(field);
+}
+
+/*
+Formats rows first to last-1 into an output buffer, after its first used bytes. cols holds the
+loaded column of each field, or NULL for user vectors, and types holds the field type of each
+field. Loaded dates and timestamps are written in ISO 8601 form, as getField() returns them.
+*/
+void TextFileWrite::_formatRows(const vector<const column*>& cols, const vector<_VT_TYPE>& types, long first, long last, vector<char>& buf, size_t& used) const
+{
+	size_t field_count = fields.size();
+	for(long row = first; row < last; row++)
+	{
+		for(size_t f = 0; f < field_count; f++)
+		{
+			if(f > 0)
+				*_reserve(buf, used++, 1) = options.delimiter;
+
+			const column* col = cols[f];
+			if(col != NULL && (types[f] == _VT_DATE || types[f] == _VT_TIMESTAMP))
+			{
+				char* pos = _reserve(buf, used, 32);
+				if(types[f] == _VT_DATE)
+					used += TextFileLoad::_formatDate((int32_t)TextFileLoad::_integerAt(*col, row), pos) - pos;
+				else
+					used += TextFileLoad::_formatTimestamp(TextFileLoad::_integerAt(*col, row), pos) - pos;
+				continue;
+			}
+			else if(col != NULL)
+			{
+				switch(col->st_type)
+				{
+					case _ST_BIT:
+						*_reserve(buf, used++, 1) = (char)('0' + ((col->st_bit[row / 64] >> (row % 64)) & 1));
+						break;
+					case _ST_INT8:
+						_appendNumber(buf, used, (int64_t)col->st_int8[row]);
+						break;
+					case _ST_INT16:
+						_appendNumber(buf, used, (int64_t)col->st_int16[row]);
+						break;
+					case _ST_INT32:
+						_appendNumber(buf, used, (int64_t)col->st_int32[row]);
+						break;
+					case _ST_INT64:
+						_appendNumber(buf, used, col->st_int64[row]);
+						break;
+					case _ST_FLOAT:
+						_appendNumber(buf, used, (double)col->st_float[row]);
+						break;
+					case _ST_DOUBLE:
+						_appendNumber(buf, used, col->st_double[row]);
+						break;
+					case _ST_STRING:
+						_appendString(buf, used, col->st_string[row]);
+				}
+				continue;
+			}
+
+			const out_field& field = fields[f];
+			switch(field.type)
+			{
+				case _VT_BOOL:
+					*_reserve(buf, used++, 1) = (*(const vector<bool>*)field.values)[row] ? '1' : '0';
+					break;
+				case _VT_INT:
+					_appendNumber(buf, used, (*(const vector<int>*)field.values)[row]);
+					break;
+				case _VT_LONG:
+					_appendNumber(buf, used, (*(const vector<long>*)field.values)[row]);
+					break;
+				case _VT_DOUBLE:
+					_appendNumber(buf, used, (*(const vector<double>*)field.values)[row]);
+					break;
+				case _VT_STRING:
+					_appendString(buf, used, (*(const vector<string>*)field.values)[row]);
+					break;
+				default:
+					break;
+			}
+		}
+		*_reserve(buf, used++, 1) = '\n';
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// PUBLIC METHODS
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+Adds every column of a loaded dataset, in order, under its field names.
+*/
+void TextFileWrite::addFields(const TextFileLoad& data)
+{
+	for(int col_num = 1; col_num <= data.getFieldCount(); col_num++)
+		addField(data, col_num);
+}
+
+/*
+Adds one column of a loaded dataset by name. Default is no case sensitivity.
+*/
+void TextFileWrite::addField(const TextFileLoad& data, string field_name, bool case_sensitive)
+{
+	addField(data, data._getColNum(field_name, case_sensitive) + 1);
+}
+
+/*
+Adds one column of a loaded dataset by number (the first column is 1).
+*/
+void TextFileWrite::addField(const TextFileLoad& data, int col_num)
+{
+	if(col_num < 1 || col_num > data.getFieldCount())
+	{
+		printf("\nColumn %d does not exist!\n", col_num);
+		exit(1);
+	}
+	out_field field;
+	field.name = data.getFieldNames()[col_num - 1];
+	field.source = &data;
+	field.col_num = col_num - 1;
+	field.type = _VT_STRING;
+	field.values = NULL;
+	field.rows = data.getRowCount();
+	fields.push_back(field);
+}
+
+/*
+Overloaded version for BOOLS.
+*/
+void TextFileWrite::addField(string field_name, const vector <bool>& col_data)
+{
+	_addVector(field_name, _VT_BOOL, &col_data, col_data.size());
+}
+
+/*
+Overloaded version for INTS.
+*/
+void TextFileWrite::addField(string field_name, const vector <int>& col_data)
+{
+	_addVector(field_name, _VT_INT, &col_data, col_data.size());
+}
+
+/*
+Overloaded version for LONGS.
+*/
+void TextFileWrite::addField(string field_name, const vector <long>& col_data)
+{
+	_addVector(field_name, _VT_LONG, &col_data, col_data.size());
+}
+
+/*
+Overloaded version for DOUBLES.
+*/
+void TextFileWrite::addField(string field_name, const vector <double>& col_data)
+{
+	_addVector(field_name, _VT_DOUBLE, &col_data, col_data.size());
+}
+
+/*
+Overloaded version for STRINGS.
+*/
+void TextFileWrite::addField(string field_name, const vector <string>& col_data)
+{
+	_addVector(field_name, _VT_STRING, &col_data, col_data.size());
+}
+
+/*
+Returns the number of columns added so far.
+*/
+long TextFileWrite::getFieldCount(void) const
+{
+	return fields.size();
+}
+
+/*
+Writes the header row (if requested) and every row of the added columns to the file, replacing
+any existing file. Exits if no columns were added, if the columns differ in length, or if the
+file cannot be written.
+
+The rows are formatted in chunks of chunk_rows. With one formatting thread and no writer thread,
+each chunk is formatted and then written by the calling thread. Otherwise the formatting threads
+take every n-th chunk and fill a ring of 2n buffers, and the calling thread writes the buffers
+out in chunk order as they become ready, so disk writes overlap with formatting.
+
+Loaded datasets are locked for the duration of the write. In memory budget mode, all of their
+columns that are written must fit in memory at once.
+*/
+void TextFileWrite::write(void)
+{
+	size_t field_count = fields.size();
+	if(field_count == 0)
+	{
+		printf("\nNo columns were added to %s!\n", filename.c_str());
+		exit(1);
+	}
+	long rows = fields[0].rows;
+	for(size_t f = 1; f < field_count; f++)
+	{
+		if(fields[f].rows != rows)
+		{
+			printf("\nColumn %s has %ld rows but column %s has %ld!\n", fields[f].name.c_str(), fields[f].rows, fields[0].name.c_str(), rows);
+			exit(1);
+		}
+	}
+
+	//Lock the loaded datasets in address order, so concurrent writes cannot deadlock, and bring
+	//their columns into memory
+	vector<const TextFileLoad*> sources;
+	for(size_t f = 0; f < field_count; f++)
+	{
+		if(fields[f].source != NULL)
+			sources.push_back(fields[f].source);
+	}
+	sort(sources.begin(), sources.end());
+	sources.erase(unique(sources.begin(), sources.end()), sources.end());
+	vector< unique_lock<recursive_mutex> > locks;
+	for(size_t s = 0; s < sources.size(); s++)
+		locks.push_back(sources[s]->_lockColumns());
+
+	vector<const column*> cols(field_count, (const column*)NULL);
+	vector<_VT_TYPE> types(field_count);
+	for(size_t f = 0; f < field_count; f++)
+	{
+		types[f] = fields[f].type;
+		if(fields[f].source != NULL)
+		{
+			cols[f] = &fields[f].source->_residentColumn(fields[f].col_num);
+			types[f] = fields[f].source->field_types[fields[f].col_num];
+		}
+	}
+	for(size_t f = 0; f < field_count; f++)
+	{
+		if(cols[f] != NULL && !cols[f]->spill_file.empty())
+		{
+			printf("\nThe memory budget is too small to write all columns of %s at once!\n", fields[f].source->filename.c_str());
+			exit(1);
+		}
+	}
+
+	ofstream out(filename.c_str(), ios::out | ios::binary | ios::trunc);
+	if(!out)
+	{
+		printf("\n\nERROR: file %s failed to open for writing!\n\n", filename.c_str());
+		exit(1);
+	}
+
+	if(options.header_row)
+	{
+		string header;
+		for(size_t f = 0; f < field_count; f++)
+		{
+			if(f > 0)
+				header += options.delimiter;
+			header += fields[f].name;
+		}
+		header += '\n';
+		out.write(header.data(), header.length());
+	}
+
+	long chunk_rows = options.chunk_rows;
+	long chunk_count = (rows + chunk_rows - 1) / chunk_rows;
+	long workers = options.threads > 0 ? options.threads : max(1u, thread::hardware_concurrency());
+	workers = max(1L, min(workers, chunk_count));
+
+	if(workers == 1 && !options.writer_thread)
+	{
+		vector<char> buf;
+		for(long chunk = 0; chunk < chunk_count; chunk++)
+		{
+			size_t used = 0;
+			_formatRows(cols, types, chunk * chunk_rows, min(rows, (chunk + 1) * chunk_rows), buf, used);
+			out.write(&buf[0], used);
+		}
+	}
+	else
+	{
+		//Chunk c is formatted into buffer c % slot_count once chunk c - slot_count has been written
+		long slot_count = 2 * workers;
+		vector< vector<char> > slots(slot_count);
+		vector<size_t> slot_used(slot_count, 0);
+		vector<long> slot_chunk(slot_count, -1);
+		long next_write = 0;
+		mutex slot_mutex;
+		condition_variable slot_ready;
+
+		vector<thread> threads;
+		for(long t = 0; t < workers; t++)
+		{
+			threads.push_back(thread([&, t]()
+			{
+				for(long chunk = t; chunk < chunk_count; chunk += workers)
+				{
+					long slot = chunk % slot_count;
+					{
+						unique_lock<mutex> lock(slot_mutex);
+						slot_ready.wait(lock, [&]() { return chunk < next_write + slot_count; });
+					}
+					size_t used = 0;
+					_formatRows(cols, types, chunk * chunk_rows, min(rows, (chunk + 1) * chunk_rows), slots[slot], used);
+					{
+						lock_guard<mutex> lock(slot_mutex);
+						slot_used[slot] = used;
+						slot_chunk[slot] = chunk;
+					}
+					slot_ready.notify_all();
+				}
+			}));
+		}
+
+		for(long chunk = 0; chunk < chunk_count; chunk++)
+		{
+			long slot = chunk % slot_count;
+			{
+				unique_lock<mutex> lock(slot_mutex);
+				slot_ready.wait(lock, [&]() { return slot_chunk[slot] == chunk; });
+			}
+			out.write(&slots[slot][0], slot_used[slot]);
+			{
+				lock_guard<mutex> lock(slot_mutex);
+				next_write = chunk + 1;
+			}
+			slot_ready.notify_all();
+		}
+		for(size_t t = 0; t < threads.size(); t++)
+			threads[t].join();
+	}
+
+	out.close();
+	if(!out)
+	{
+		printf("\n\nERROR: failed to write file %s!\n\n", filename.c_str());
+		exit(1);
+	}
+}
@@ -0,0 +1,116 @@
+#ifndef __TEXTFILEWRITE_H
+#define __TEXTFILEWRITE_H
+/////////////////////////////////////////////////////////////////////////////
+// Terms of Agreement: By using this code, you agree to the following terms...
+// 1) You may use this code in your own programs (and may compile it into a program and distribute
+//    it in compiled format for languages that allow it) freely and at no charge.
+// 2) You MAY NOT redistribute this code (for example to a web site). Failure to do so is a
+//    violation of copyright laws.
+// 3) You use this code at your own risk.
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// TextFileWrite is the output counterpart of TextFileLoad. It writes columns of data to a
+// delimited text file, one row per line, with the same delimiter and header row conventions
+// that TextFileLoad reads. Columns can come from vectors computed by the user, from a loaded
+// dataset, or both.
+//
+// Columns are added by reference: nothing is copied until write() is called, so the vectors
+// (and loaded datasets) must not change or go out of scope before then. All columns must have
+// the same number of rows. Numbers are formatted straight into large output buffers in their
+// shortest exact form, bools as 0/1, loaded dates and timestamps in ISO 8601 form, and strings
+// unchanged (TextFileLoad does not support quoting, so strings should not contain the delimiter
+// or line breaks).
+//
+// Large files are formatted in chunks of rows on several threads at once, and the chunks are
+// written out in row order while the next ones are being formatted.
+//
+//
+// USER OPTIONS
+// 1) delimiter (default is tab-delimited)
+// 2) header row (default writes the field names as the first row)
+// 3) TextFileWriteOptions: number of formatting threads, whether disk writes overlap with
+//    formatting, and the number of rows per output buffer
+//
+//
+// EXAMPLE CLASS INITIALIZATIONS
+//		1. (tab file): TextFileWrite TFWobj("output.tab");
+//		2. (csv file, no header row): TextFileWrite TFWobj("output.csv", ',', false);
+//
+//
+// EXAMPLE DATA WRITES
+//		1. (every column of a loaded dataset): TFWobj.addFields(TFLobj); TFWobj.write();
+//		2. (one loaded column and a computed one):
+//				TFWobj.addField(TFLobj, "Year");
+//				TFWobj.addField("Year squared", my_vector);
+//				TFWobj.write();
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "TextFileLoad.h"
+
+/*
+WRITE OPTIONS
+Collects the settings used by the TextFileWrite(string, TextFileWriteOptions) constructor. The
+defaults match those of the other constructors.
+*/
+struct TextFileWriteOptions
+{
+	char delimiter;
+	bool header_row;
+
+	int threads;			//number of threads that format rows; 0 = one per core
+	bool writer_thread;		//if true, disk writes overlap with formatting even when only one thread formats
+	long chunk_rows;		//rows formatted into each output buffer
+
+	TextFileWriteOptions(char delimit='\t', bool headers=true)
+		: delimiter(delimit), header_row(headers), threads(0), writer_thread(true), chunk_rows(65536) {}
+};
+
+class TextFileWrite
+{
+
+private:
+	//One output column: column col_num of a loaded dataset, or a user vector of the given type
+	struct out_field
+	{
+		string name;
+		const TextFileLoad* source;
+		int col_num;
+		_VT_TYPE type;
+		const void* values;
+		long rows;
+	};
+
+	//PRIVATE MEMBERS
+	string filename;
+	TextFileWriteOptions options;
+	vector<out_field> fields;
+
+	//PRIVATE METHODS
+	void _addVector(string name, _VT_TYPE type, const void* values, long rows);
+	void _formatRows(const vector<const column*>& cols, const vector<_VT_TYPE>& types, long first, long last, vector<char>& buf, size_t& used) const;
+
+public:
+	//CONSTRUCTORS
+	TextFileWrite(string textfile, bool header_row=true);
+	TextFileWrite(string textfile, char delimit, bool header_row=true);
+	TextFileWrite(string textfile, const TextFileWriteOptions& opts);
+
+	//PUBLIC METHODS
+	//Columns of a loaded dataset
+	void addFields(const TextFileLoad& data);
+	void addField(const TextFileLoad& data, string field_name, bool case_sensitive=false);
+	void addField(const TextFileLoad& data, int col_num);
+	//Overloaded addField methods for user vectors
+	void addField(string field_name, const vector <bool>& col_data);
+	void addField(string field_name, const vector <int>& col_data);
+	void addField(string field_name, const vector <long>& col_data);
+	void addField(string field_name, const vector <double>& col_data);
+	void addField(string field_name, const vector <string>& col_data);
+	long getFieldCount(void) const;
+	//Writes the file
+	void write(void);
+};
+#endif
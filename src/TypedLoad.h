@@ -0,0 +1,322 @@
+#ifndef __TYPEDLOAD_H
+#define __TYPEDLOAD_H
+/////////////////////////////////////////////////////////////////////////////
+// Terms of Agreement: By using this code, you agree to the following terms...
+// 1) You may use this code in your own programs (and may compile it into a program and distribute
+//    it in compiled format for languages that allow it) freely and at no charge.
+// 2) You MAY NOT redistribute this code (for example to a web site). Failure to do so is a
+//    violation of copyright laws.
+// 3) You use this code at your own risk.
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// TypedLoad is a compile-time counterpart of TextFileLoad for files whose column types are
+// known in advance. The user lists the column types as template arguments, and the compiler
+// generates a dedicated tokenize-and-convert loop for that layout: there is no type inference,
+// no per-cell type dispatch, and no variant. Each column is stored in a vector of its declared
+// type. Use TextFileLoad for files whose layout is not known in advance.
+//
+// Supported column types are bool, the integer types, float, double, string and string_view.
+// string_view columns point into a copy of the file held by the TypedLoad object, so they
+// remain valid for as long as that object exists; for that reason TypedLoad objects cannot be
+// copied or moved. As in TextFileLoad, nulls are loaded as 0
+// (or blank) and values that cannot be converted to the declared type, or are out of its range,
+// are loaded as 0.
+//
+// TypedLoad is header-only and requires C++17 (e.g., g++ -std=c++17).
+//
+//
+// EXAMPLE CLASS INITIALIZATIONS
+//		1. (tab file): TypedLoad<int, long, long, string_view, bool, double> TLobj("sample text.tab");
+//		2. (csv file, no header row): TypedLoad<int64_t, double> TLobj("sample text.csv", ',', false);
+//
+//
+// EXAMPLE DATA LOADS
+//		1. (reference to the third column): const vector<string_view>& v = TLobj.getField<2>();
+//		2. (copy of the first column): vector<int> my_vector = TLobj.getField<0>();
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <charconv>
+#include <type_traits>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+
+template <typename... Ts>
+class TypedLoad
+{
+
+private:
+	//PRIVATE MEMBERS
+	char delimiter;
+	bool header_row;
+	string filename;
+	string buffer; // Entire file contents. string_view columns point into this.
+	vector<string> field_names;
+	tuple< vector<Ts>... > columns;
+	long row_count;
+
+	//PRIVATE METHODS
+	void _readFile(void);
+	void _getData(void);
+	void _splitLine(const char* first, const char* last, vector<string>& fields);
+	const char* _lineEnd(const char* first, const char* last);
+
+	template <size_t... Is>
+	void _parseRow(const char* first, const char* last, index_sequence<Is...>);
+
+	template <size_t I>
+	void _parseField(const char*& first, const char* last);
+
+	template <typename T>
+	static void _convert(const char* first, const char* last, T& value);
+
+public:
+	//CONSTRUCTOR
+	TypedLoad(string textfile, char delimit='\t', bool header_row=true);
+
+	//string_view columns point into buffer, so a copy would point into its source
+	TypedLoad(const TypedLoad&) = delete;
+	TypedLoad& operator=(const TypedLoad&) = delete;
+	TypedLoad(TypedLoad&&) = delete;
+	TypedLoad& operator=(TypedLoad&&) = delete;
+
+	//PUBLIC METHODS
+	const vector<string>& getFieldNames(void) const { return field_names; }
+	long getFieldCount(void) const { return (long)sizeof...(Ts); }
+	long getRowCount(void) const { return row_count; }
+
+	//Returns the column at position I (0-based) as a vector of its declared type
+	template <size_t I>
+	const typename tuple_element< I, tuple< vector<Ts>... > >::type& getField(void) const
+	{
+		return get<I>(columns);
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// CONSTRUCTOR
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+Loads the file. Default arguments are a tab delimiter and a header row.
+*/
+template <typename... Ts>
+TypedLoad<Ts...>::TypedLoad(string textfile, char delimit, bool headers)
+{
+	filename = textfile;
+	delimiter = delimit;
+	header_row = headers;
+	row_count = 0;
+
+	_readFile();
+	_getData();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PRIVATE METHODS
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+Reads the entire file into the buffer and issues an error if the file fails to open.
+*/
+template <typename... Ts>
+void TypedLoad<Ts...>::_readFile(void)
+{
+	ifstream in_stream(filename.c_str(), ios::in | ios::binary);
+	if(!in_stream)
+	{
+		printf("\n\nERROR: file failed to open!\n\n");
+		exit(1);
+	}
+
+	ostringstream contents;
+	contents << in_stream.rdbuf();
+	buffer = contents.str();
+}
+
+/*
+Returns a pointer to the end of the line that starts at first, excluding any '\r'.
+*/
+template <typename... Ts>
+const char* TypedLoad<Ts...>::_lineEnd(const char* first, const char* last)
+{
+	const char* eol = (const char*)memchr(first, '\n', last - first);
+	if(eol == NULL)
+		eol = last;
+	if(eol > first && eol[-1] == '\r')
+		eol--;
+	return eol;
+}
+
+/*
+Splits the line [first, last) at the delimiter into fields.
+*/
+template <typename... Ts>
+void TypedLoad<Ts...>::_splitLine(const char* first, const char* last, vector<string>& fields)
+{
+	fields.clear();
+	while(true)
+	{
+		const char* delim = (const char*)memchr(first, delimiter, last - first);
+		if(delim == NULL)
+		{
+			fields.push_back(string(first, last));
+			break;
+		}
+		fields.push_back(string(first, delim));
+		first = delim + 1;
+	}
+}
+
+/*
+Reads the header row, if any, and then converts every line straight into the typed columns.
+Empty lines are skipped. The number of columns is that of the header row, or of the first line
+if there is none, and must match the number of declared types.
+*/
+template <typename... Ts>
+void TypedLoad<Ts...>::_getData(void)
+{
+	const char* pos = buffer.data();
+	const char* last = pos + buffer.size();
+
+	if(header_row)
+	{
+		const char* eol = _lineEnd(pos, last);
+		if(eol == pos)
+		{
+			printf("\nFirst row is empty!\n");
+			exit(1);
+		}
+		_splitLine(pos, eol, field_names);
+		if(field_names.size() != sizeof...(Ts))
+		{
+			printf("\nFile has %d columns but %d types were declared!\n", (int)field_names.size(), (int)sizeof...(Ts));
+			exit(1);
+		}
+		pos = (const char*)memchr(pos, '\n', last - pos);
+		pos = (pos == NULL) ? last : pos + 1;
+	}
+	else
+	{
+		//Check the column count on the first non-empty line
+		const char* line = pos;
+		const char* eol = _lineEnd(line, last);
+		while(eol == line && line < last)
+		{
+			line = (const char*)memchr(line, '\n', last - line);
+			line = (line == NULL) ? last : line + 1;
+			eol = _lineEnd(line, last);
+		}
+		vector<string> first_fields;
+		_splitLine(line, eol, first_fields);
+		if(eol > line && first_fields.size() != sizeof...(Ts))
+		{
+			printf("\nFile has %d columns but %d types were declared!\n", (int)first_fields.size(), (int)sizeof...(Ts));
+			exit(1);
+		}
+	}
+
+	while(pos < last)
+	{
+		const char* eol = _lineEnd(pos, last);
+		if(eol > pos)
+		{
+			_parseRow(pos, eol, index_sequence_for<Ts...>());
+			row_count++;
+		}
+		pos = (const char*)memchr(eol, '\n', last - eol);
+		pos = (pos == NULL) ? last : pos + 1;
+	}
+}
+
+/*
+Converts one line into one value per column. The comma fold expands to one _parseField call
+per column, in column order, so the row loop contains no type dispatch.
+*/
+template <typename... Ts>
+template <size_t... Is>
+void TypedLoad<Ts...>::_parseRow(const char* first, const char* last, index_sequence<Is...>)
+{
+	(_parseField<Is>(first, last), ...);
+}
+
+/*
+Converts the field that starts at first into column I and advances first past its delimiter.
+Missing trailing fields are loaded as nulls.
+*/
+template <typename... Ts>
+template <size_t I>
+void TypedLoad<Ts...>::_parseField(const char*& first, const char* last)
+{
+	const char* delim = (const char*)memchr(first, delimiter, last - first);
+	const char* field_end = (delim == NULL) ? last : delim;
+
+	typename tuple_element< I, tuple<Ts...> >::type value = typename tuple_element< I, tuple<Ts...> >::type();
+	_convert(first, field_end, value);
+	get<I>(columns).push_back(std::move(value));
+
+	first = (delim == NULL) ? last : delim + 1;
+}
+
+/*
+Converts the characters [first, last) into a value of type T. Numbers may be surrounded by
+spaces and may carry a leading '+'. Values that cannot be converted are loaded as 0.
+*/
+template <typename... Ts>
+template <typename T>
+void TypedLoad<Ts...>::_convert(const char* first, const char* last, T& value)
+{
+	if constexpr (is_same<T, string>::value)
+		value.assign(first, last);
+	else if constexpr (is_same<T, string_view>::value)
+		value = string_view(first, last - first);
+	else
+	{
+		while(first < last && *first == ' ')
+			first++;
+		while(last > first && last[-1] == ' ')
+			last--;
+		if(first < last && *first == '+')
+			first++;
+
+		if constexpr (is_same<T, bool>::value)
+		{
+			long tmp = 0;
+			from_chars(first, last, tmp);
+			value = (tmp != 0);
+		}
+		else if constexpr (is_integral<T>::value)
+		{
+			//Integers written in scientific or decimal notation are truncated, as atol would do.
+			//The truncated value must be in range for the cast to be defined.
+			from_chars_result res = from_chars(first, last, value);
+			if(res.ptr != last)
+			{
+				double tmp = 0;
+				if(from_chars(first, last, tmp).ptr != last)
+					tmp = 0;
+				tmp = trunc(tmp);
+				bool in_range = (tmp >= (double)numeric_limits<T>::min() && tmp < (double)numeric_limits<T>::max() + 1.0);
+				value = in_range ? (T)tmp : 0;
+			}
+		}
+		else if(from_chars(first, last, value).ptr != last)
+			value = 0;
+	}
+}
+
+#endif
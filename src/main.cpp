@@ -16,7 +16,7 @@
 // Full documentation is provided in TextFileLoad.h
 //
 // To compile this example under Cygwin:
-// 		g++ TextFileLoad.h TextFileLoad.cpp main.cpp -o main.exe
+// 		g++ -std=c++17 -pthread TextFileLoad.h TextFileLoad.cpp main.cpp -o main.exe
 //
 // To run this example under Cygwin:
 //		./main
@@ -0,0 +1,351 @@
+/////////////////////////////////////////////////////////////////////////////
+// Terms of Agreement: By using this code, you agree to the following terms...
+// 1) You may use this code in your own programs (and may compile it into a program and distribute
+//    it in compiled format for languages that allow it) freely and at no charge.
+// 2) You MAY NOT redistribute this code (for example to a web site). Failure to do so is a
+//    violation of copyright laws.
+// 3) You use this code at your own risk.
+/////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// tfl_tool is a command-line front end to the TextFileLoad class, for looking at a text file
+// without writing any code. It loads the file with the load options given on the command line
+// and prints the schema, the row count, statistics for each column and the time spent in each
+// phase of the load. It can also convert the file to another delimited file or save its
+// row-offset index, so that later loads of the file that name the index (-L here, or
+// TextFileLoadOptions::index_file) seek straight to their rows.
+//
+// Full documentation of the load options is provided in TextFileLoad.h
+//
+// To compile:
+// 		g++ -std=c++17 -O2 -pthread TextFileLoad.cpp TextFileWrite.cpp tfl_tool.cpp -o tfl_tool
+//
+// To run (run without arguments for the list of options):
+//		./tfl_tool "sample_text.tab"
+//		./tfl_tool -d , -r 1000:5000 -c "Year,double data" data.csv
+//		./tfl_tool -x -m 500000000 -i 10000 -o data.tab data.csv
+//		./tfl_tool -I 1024 data.tab; ./tfl_tool -L data.tab.idx -r -100:-1 data.tab
+/////////////////////////////////////////////////////////////////////////////
+
+#include "TextFileLoad.h"
+#include "TextFileWrite.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <unordered_set>
+
+/*
+Prints the command-line options and exits.
+*/
+static void usage(void)
+{
+	printf("Usage: tfl_tool [options] file\n\n");
+	printf("Load options:\n");
+	printf("  -d <char>        delimiter (default: tab; \"tab\" and \"space\" are accepted)\n");
+	printf("  -n               the file has no header row\n");
+	printf("  -f <layout>      fixed-width file: comma-separated name:start:length fields (start is 0-based)\n");
+	printf("  -r <first:max>   load max rows (-1 = all) starting at row first (negative = from the end)\n");
+	printf("  -s <rows>        load a random sample of this many rows\n");
+	printf("  -L <file>        use a row-offset index saved with -I to select the rows\n");
+	printf("  -i <rows>        infer the types from a sample of this many rows\n");
+	printf("  -e <encoding>    utf-8, latin-1, utf-16le or utf-16be (default: detect)\n");
+	printf("  -m <bytes>       memory budget for the loaded columns\n");
+	printf("  -x               compact storage\n");
+	printf("\nOutput options:\n");
+	printf("  -c <columns>     only print statistics for these comma-separated columns: names, or\n");
+	printf("                   1-based numbers (the only way to pick columns with -n)\n");
+	printf("  -q               do not print column statistics\n");
+	printf("  -o <file>        write the loaded rows to a delimited file\n");
+	printf("  -D <char>        delimiter of the -o file (default: that of the input)\n");
+	printf("  -I <stride>      save a row-offset index with this stride as file.idx\n");
+	exit(1);
+}
+
+/*
+Returns the value of the option at argv[i], and exits if it is missing.
+*/
+static string optionValue(int argc, char** argv, int& i)
+{
+	if(i + 1 >= argc)
+	{
+		printf("\nOption %s needs a value!\n", argv[i]);
+		exit(1);
+	}
+	return argv[++i];
+}
+
+/*
+Returns a delimiter given on the command line as a character or by name.
+*/
+static char delimiterValue(string value)
+{
+	if(value == "tab" || value == "\\t")
+		return '\t';
+	if(value == "space")
+		return ' ';
+	if(value.length() != 1)
+	{
+		printf("\nDelimiter %s must be a single character!\n", value.c_str());
+		exit(1);
+	}
+	return value[0];
+}
+
+/*
+Splits a comma-separated list.
+*/
+static vector<string> splitList(string list)
+{
+	vector<string> items;
+	size_t first = 0;
+	while(first <= list.length())
+	{
+		size_t next = list.find(',', first);
+		if(next == string::npos)
+			next = list.length();
+		if(next > first)
+			items.push_back(list.substr(first, next - first));
+		first = next + 1;
+	}
+	return items;
+}
+
+/*
+Prints the statistics of one column, according to its type: true count for booleans, range and
+mean for numbers, range for dates and timestamps, and blank count, distinct count and lengths for
+strings. Nulls are loaded as 0 (or 1970-01-01), so they count as values for all but strings.
+*/
+static void printColumnStats(const TextFileLoad& data, int col_num)
+{
+	string type = data.getFieldTypes()[col_num-1];
+	long rows = data.getRowCount();
+	printf("  %-24s %-9s %-6s", data.getFieldNames().empty() ? ("column " + to_string(col_num)).c_str() :
+		data.getFieldNames()[col_num-1].c_str(), type.c_str(), data.getStorageTypes()[col_num-1].c_str());
+	if(rows == 0)
+	{
+		printf("\n");
+		return;
+	}
+
+	if(type == "BOOLEAN")
+	{
+		long set = data.countBits(data.getBitmap(col_num));
+		printf("  true %ld (%.1f%%)\n", set, 100.0 * set / rows);
+	}
+	else if(type == "INT" || type == "LONG")
+	{
+		vector<long> values;
+		data.getField(col_num, values);
+		long min_value = *min_element(values.begin(), values.end());
+		long max_value = *max_element(values.begin(), values.end());
+		double sum = 0;
+		for(size_t i = 0; i < values.size(); i++)
+			sum += values[i];
+		printf("  min %ld  max %ld  mean %.6g\n", min_value, max_value, sum / rows);
+	}
+	else if(type == "DOUBLE")
+	{
+		vector<double> values;
+		data.getField(col_num, values);
+		double min_value = *min_element(values.begin(), values.end());
+		double max_value = *max_element(values.begin(), values.end());
+		double sum = 0;
+		for(size_t i = 0; i < values.size(); i++)
+			sum += values[i];
+		printf("  min %.10g  max %.10g  mean %.6g\n", min_value, max_value, sum / rows);
+	}
+	else if(type == "DATE" || type == "TIMESTAMP")
+	{
+		//ISO 8601 text sorts in time order
+		vector<string> values;
+		data.getField(col_num, values);
+		printf("  min %s  max %s\n", min_element(values.begin(), values.end())->c_str(),
+			max_element(values.begin(), values.end())->c_str());
+	}
+	else
+	{
+		vector<string> values;
+		data.getField(col_num, values);
+		unordered_set<string> distinct(values.begin(), values.end());
+		long blanks = 0;
+		size_t min_length = values[0].length(), max_length = 0;
+		for(size_t i = 0; i < values.size(); i++)
+		{
+			blanks += values[i].empty();
+			min_length = min(min_length, values[i].length());
+			max_length = max(max_length, values[i].length());
+		}
+		printf("  blank %ld  distinct %ld  length %zu-%zu\n", blanks, (long)distinct.size(), min_length, max_length);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	TextFileLoadOptions opts;
+	vector<string> stat_fields;
+	bool print_stats = true;
+	string out_file;
+	char out_delimiter = 0;
+	long index_stride = 0;
+	string filename;
+
+	//Read the command line
+	for(int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if(arg == "-d")
+			opts.delimiter = delimiterValue(optionValue(argc, argv, i));
+		else if(arg == "-n")
+			opts.header_row = false;
+		else if(arg == "-f")
+		{
+			vector<string> fields = splitList(optionValue(argc, argv, i));
+			for(size_t f = 0; f < fields.size(); f++)
+			{
+				char name[256];
+				long start, length;
+				if(sscanf(fields[f].c_str(), "%255[^:]:%ld:%ld", name, &start, &length) != 3)
+				{
+					printf("\nFixed-width field %s is not name:start:length!\n", fields[f].c_str());
+					exit(1);
+				}
+				opts.fixed_width.push_back(fixed_width_field(name, start, length));
+			}
+		}
+		else if(arg == "-r")
+		{
+			if(sscanf(optionValue(argc, argv, i).c_str(), "%ld:%ld", &opts.first_row, &opts.max_rows) < 1)
+				usage();
+		}
+		else if(arg == "-s")
+			opts.sample_rows = atol(optionValue(argc, argv, i).c_str());
+		else if(arg == "-L")
+			opts.index_file = optionValue(argc, argv, i);
+		else if(arg == "-i")
+			opts.infer_rows = atol(optionValue(argc, argv, i).c_str());
+		else if(arg == "-e")
+		{
+			string encoding = optionValue(argc, argv, i);
+			if(encoding == "utf-8")
+				opts.encoding = _ENC_UTF8;
+			else if(encoding == "latin-1")
+				opts.encoding = _ENC_LATIN1;
+			else if(encoding == "utf-16le")
+				opts.encoding = _ENC_UTF16LE;
+			else if(encoding == "utf-16be")
+				opts.encoding = _ENC_UTF16BE;
+			else
+				usage();
+		}
+		else if(arg == "-m")
+			opts.memory_budget = atol(optionValue(argc, argv, i).c_str());
+		else if(arg == "-x")
+			opts.compact = true;
+		else if(arg == "-c")
+			stat_fields = splitList(optionValue(argc, argv, i));
+		else if(arg == "-q")
+			print_stats = false;
+		else if(arg == "-o")
+			out_file = optionValue(argc, argv, i);
+		else if(arg == "-D")
+			out_delimiter = delimiterValue(optionValue(argc, argv, i));
+		else if(arg == "-I")
+			index_stride = atol(optionValue(argc, argv, i).c_str());
+		else if(arg.length() > 1 && arg[0] == '-')
+			usage();
+		else
+			filename = arg;
+	}
+	if(filename.empty())
+		usage();
+
+	//Load the file
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	TextFileLoad data(filename, opts);
+	double load_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	//Schema and size
+	ifstream in(filename.c_str(), ios::in | ios::binary | ios::ate);
+	double megabytes = in.tellg() / 1e6;
+	printf("File:      %s (%.1f MB, %s)\n", filename.c_str(), megabytes, data.getEncoding().c_str());
+	printf("Rows:      %ld\n", data.getRowCount());
+	printf("Columns:   %ld\n", data.getFieldCount());
+	printf("Storage:   %.1f MB\n", data.getStorageBytes() / 1e6);
+
+	load_timings timings = data.getLoadTimings();
+	printf("\nLoad time: %.3f s (%.1f MB/s)\n", load_seconds, load_seconds > 0 ? megabytes / load_seconds : 0.0);
+	printf("  open and header  %.3f s\n", timings.open_seconds);
+	printf("  types            %.3f s\n", timings.types_seconds);
+	printf("  parse            %.3f s\n", timings.parse_seconds);
+	printf("  index/compact    %.3f s\n", timings.finish_seconds);
+
+	vector<long> mismatches = data.getTypeMismatches();
+	vector<long> promotions = data.getTypePromotions();
+	for(int col_num = 0; col_num < data.getFieldCount(); col_num++)
+	{
+		if(mismatches[col_num] > 0)
+			printf("  column %d: %ld values did not fit the declared type\n", col_num+1, mismatches[col_num]);
+		if(promotions[col_num] > 0)
+			printf("  column %d: promoted %ld times while loading\n", col_num+1, promotions[col_num]);
+	}
+
+	//Column statistics
+	if(print_stats)
+	{
+		printf("\nColumns (name, type, storage, statistics):\n");
+		chrono::steady_clock::time_point stats_start = chrono::steady_clock::now();
+		if(stat_fields.empty())
+		{
+			for(int col_num = 1; col_num <= data.getFieldCount(); col_num++)
+				printColumnStats(data, col_num);
+		}
+		const vector<string>& names = data.getFieldNames();
+		for(size_t f = 0; f < stat_fields.size(); f++)
+		{
+			int col_num = 0;
+			for(size_t c = 0; c < names.size(); c++)
+			{
+				if(strcasecmp(names[c].c_str(), stat_fields[f].c_str()) == 0)
+					col_num = c + 1;
+			}
+
+			//A column that is not named by the header can be given by its number
+			if(col_num == 0 && !stat_fields[f].empty() && stat_fields[f].find_first_not_of("0123456789") == string::npos)
+			{
+				long number = atol(stat_fields[f].c_str());
+				if(number <= data.getFieldCount())
+					col_num = (int)number;
+			}
+			if(col_num == 0)
+			{
+				printf("\nColumn %s does not exist!\n", stat_fields[f].c_str());
+				exit(1);
+			}
+			printColumnStats(data, col_num);
+		}
+		printf("Statistics time: %.3f s\n", chrono::duration<double>(chrono::steady_clock::now() - stats_start).count());
+	}
+
+	//Conversions
+	if(!out_file.empty())
+	{
+		start = chrono::steady_clock::now();
+		TextFileWrite out(out_file, TextFileWriteOptions(out_delimiter ? out_delimiter : opts.delimiter, opts.header_row));
+		out.addFields(data);
+		out.write();
+		printf("\nWrote %s in %.3f s\n", out_file.c_str(), chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	}
+	if(index_stride > 0)
+	{
+		start = chrono::steady_clock::now();
+		data.buildRowIndex(index_stride);
+		data.saveRowIndex();
+		printf("\nSaved the row index of %s to %s.idx in %.3f s (load with -L %s.idx)\n", filename.c_str(), filename.c_str(),
+			chrono::duration<double>(chrono::steady_clock::now() - start).count(), filename.c_str());
+	}
+	return 0;
+}